@@ -0,0 +1,48 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outUV;
+
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+struct Instance {
+    mat4 worldMatrix;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
+//push constants block
+layout(push_constant) uniform constants
+{
+    VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
+    uvec2 virtualTextures; // Device address of the page tables as two uints, only read by fragment shaders sampling virtual textures
+} PushConstants;
+
+void main()
+{
+    //load vertex data from device address
+    Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+
+    // firstInstance of the batch is already part of gl_InstanceIndex
+    mat4 worldMatrix = PushConstants.instanceBuffer.instances[gl_InstanceIndex].worldMatrix;
+
+    //output data
+    gl_Position = worldMatrix * vec4(v.position, 1.0f);
+    outColor = v.color.xyz;
+    outUV.x = v.uv_x;
+    outUV.y = v.uv_y;
+}
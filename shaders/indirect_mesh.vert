@@ -0,0 +1,49 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outUV;
+
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+struct Object {
+    mat4 worldMatrix;
+    vec4 boundingSphere;
+    uint firstIndex;
+    uint indexCount;
+    int vertexOffset;
+    uint padding;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectBuffer {
+    Object objects[];
+};
+
+layout(push_constant) uniform constants
+{
+    mat4 viewProjection;
+    ObjectBuffer objectBuffer;
+    VertexBuffer vertexBuffer;
+} PushConstants;
+
+void main()
+{
+    // The cull pass stores the object index as firstInstance, and the vertex offset is already part of gl_VertexIndex
+    Object object = PushConstants.objectBuffer.objects[gl_InstanceIndex];
+    Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+
+    gl_Position = PushConstants.viewProjection * object.worldMatrix * vec4(v.position, 1.0f);
+    outColor = v.color.xyz;
+    outUV.x = v.uv_x;
+    outUV.y = v.uv_y;
+}
@@ -0,0 +1,82 @@
+// Sampling of virtual textures, include it in fragment shaders. Needs GL_EXT_buffer_reference and GL_EXT_nonuniform_qualifier,
+// and the device needs fragmentStoresAndAtomics for the feedback writes.
+// Layouts match vk_gpu_virtual_texture_system, vk_gpu_virtual_texture and vk_gpu_virtual_texture_feedback in vk_virtual_texture.h
+
+// Every 4x4 block of pixels writes the page it wants from one pixel, a different one each frame
+#define VT_FEEDBACK_PERIOD 16
+
+// The page tables are R32_UINT images in the sampled image array of the bindless heap, the atlas a regular one
+layout(set = 0, binding = 0) uniform utexture2D vtPageTables[];
+layout(set = 0, binding = 0) uniform texture2D vtTextures[];
+layout(set = 0, binding = 2) uniform sampler vtSamplers[];
+
+layout(buffer_reference, std430) buffer VirtualTextureFeedback {
+    uint count;
+    uint capacity;
+    uint padding0;
+    uint padding1;
+    uint requests[];
+};
+
+struct VirtualTexture {
+    uint pageTableIndex;
+    uint width;
+    uint height;
+    uint mipCount;
+};
+
+layout(buffer_reference, std430) readonly buffer VirtualTextureSystem {
+    VirtualTextureFeedback feedback;
+    uint atlasIndex;
+    uint samplerIndex;
+    uint pageSize;
+    uint pageBorder;
+    uint atlasSize;
+    uint feedbackPhase;
+    uint textureCount;
+    uint padding[3];
+    VirtualTexture textures[];
+};
+
+vec4 vt_sample(VirtualTextureSystem vt, uint textureId, vec2 uv)
+{
+    VirtualTexture tex = vt.textures[textureId];
+    vec2 size = vec2(tex.width, tex.height);
+    uv = fract(uv);
+
+    // Mip from the screen space footprint in texels of mip 0
+    vec2 dx = dFdx(uv * size);
+    vec2 dy = dFdy(uv * size);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    uint mip = uint(clamp(lod, 0.0, float(tex.mipCount - 1)));
+
+    uvec2 mipSize = max(uvec2(tex.width, tex.height) >> mip, uvec2(1));
+    uvec2 page = min(uvec2(uv * vec2(mipSize)) / vt.pageSize, max(mipSize / vt.pageSize, uvec2(1)) - 1);
+
+    uvec2 pixel = uvec2(gl_FragCoord.xy) & 3;
+    if(pixel.x + pixel.y * 4 == vt.feedbackPhase) {
+        uint request = atomicAdd(vt.feedback.count, 1);
+        if(request < vt.feedback.capacity) {
+            vt.feedback.requests[request] = (textureId << 24) | (mip << 20) | (page.y << 10) | page.x;
+        }
+    }
+
+    // The entry points at the requested page, or at the closest coarser one that is resident
+    uint entry = texelFetch(vtPageTables[nonuniformEXT(tex.pageTableIndex)], ivec2(page), int(mip)).r;
+    if((entry & 0x80000000u) == 0) {
+        return vec4(0.5, 0.5, 0.5, 1.0);
+    }
+
+    uint residentMip = (entry >> 24) & 0xFu;
+    uvec2 slot = uvec2(entry & 0xFFFu, (entry >> 12) & 0xFFFu);
+
+    // Position inside the resident page, in its own mip's texels
+    vec2 residentSize = vec2(max(uvec2(tex.width, tex.height) >> residentMip, uvec2(1)));
+    vec2 texel = uv * residentSize;
+    vec2 inPage = texel - floor(texel / float(vt.pageSize)) * float(vt.pageSize);
+
+    float slotSize = float(vt.pageSize + 2 * vt.pageBorder);
+    vec2 atlasTexel = vec2(slot) * slotSize + float(vt.pageBorder) + inPage;
+
+    return textureLod(sampler2D(vtTextures[nonuniformEXT(vt.atlasIndex)], vtSamplers[nonuniformEXT(vt.samplerIndex)]), atlasTexel / float(vt.atlasSize), 0.0);
+}
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "virtual_texture.glsl"
+
+//shader input
+layout (location = 1) in vec2 inUV;
+
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+//push constants block, the vertex shader reads the first two addresses
+layout(push_constant) uniform constants
+{
+    uvec2 vertexBuffer;
+    uvec2 instanceBuffer;
+    VirtualTextureSystem virtualTextures;
+    uint virtualTexture;
+} PushConstants;
+
+void main()
+{
+    outFragColor = vt_sample(PushConstants.virtualTextures, PushConstants.virtualTexture, inUV);
+}
@@ -1,18 +1,76 @@
+#include <cctype>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 
 #include <GLFW/glfw3.h>
 
 #include "vulkan/vk_renderer.h"
 
-int main()
+// Renders a fixed amount of frames without a window and reports the throughput
+int run_headless(u32 frame_count, bool async_compute, bool dynamic_resolution, u32 test_objects, const std::string& virtual_texture)
 {
+    vk_renderer renderer = vk_renderer(vk_renderer_config{ .window_ptr = nullptr, .width = 800, .height = 600, .async_compute = async_compute, .dynamic_resolution = dynamic_resolution, .test_scene_objects = test_objects, .virtual_texture_path = virtual_texture });
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for(u32 i = 0; i < frame_count; i++) {
+        renderer.draw_frame();
+    }
+
+    renderer.get_profiler().dump_csv("frame_timings.csv");
+    renderer.destroy();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    f64 seconds = std::chrono::duration<f64>(end - start).count();
+
+    std::cout << "Rendered " << frame_count << " headless frames in " << seconds << "s (" << frame_count / seconds << " fps)\n";
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    // vk_renderer_bug [--async-compute] [--hot-reload] [--dynamic-resolution] [--test-objects count] [--virtual-texture file] [--headless [frame_count]]
+    bool async_compute = false;
+    bool hot_reload = false;
+    bool dynamic_resolution = false;
+    bool headless = false;
+    u32 frame_count = 1000;
+    u32 test_objects = 0;
+    std::string virtual_texture;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--async-compute") == 0) {
+            async_compute = true;
+        } else if(strcmp(argv[i], "--hot-reload") == 0) {
+            hot_reload = true;
+        } else if(strcmp(argv[i], "--dynamic-resolution") == 0) {
+            dynamic_resolution = true;
+        } else if(strcmp(argv[i], "--test-objects") == 0 && i + 1 < argc) {
+            test_objects = (u32)std::stoul(argv[++i]);
+        } else if(strcmp(argv[i], "--virtual-texture") == 0 && i + 1 < argc) {
+            virtual_texture = argv[++i];
+        } else if(strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+
+            if(i + 1 < argc && isdigit(argv[i + 1][0])) {
+                frame_count = (u32)std::stoul(argv[++i]);
+            }
+        }
+    }
+
+    if(headless) {
+        return run_headless(frame_count, async_compute, dynamic_resolution, test_objects, virtual_texture);
+    }
+
     // Create a Window
     if(!glfwInit()) {
         throw std::runtime_error("Failed to init GLFW");
     }
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     GLFWwindow* glfw_window = glfwCreateWindow(800, 600, "vk_renderer_bug", 0, 0);
     if(!glfw_window) {
@@ -23,7 +81,7 @@ int main()
 
     std::cout << "What is going on";
 
-    vk_renderer renderer = vk_renderer(glfw_window);
+    vk_renderer renderer = vk_renderer(vk_renderer_config{ .window_ptr = glfw_window, .async_compute = async_compute, .hot_reload_shaders = hot_reload, .dynamic_resolution = dynamic_resolution, .test_scene_objects = test_objects, .virtual_texture_path = virtual_texture });
 
     while(!glfwWindowShouldClose(glfw_window)) {
         glfwPollEvents();
@@ -0,0 +1,117 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_depth_pyramid.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "vk_initializers.h"
+
+void vk_depth_pyramid::init(VkDevice device, VmaAllocator allocator, vk_bindless_heap* heap, VkExtent2D depth_extent) {
+    this->device = device;
+    this->allocator = allocator;
+    this->heap = heap;
+
+    // Rounding down keeps every level exactly half of the previous one, so a texel always reduces a 2x2 block.
+    // Level 0 then covers at most 2x2 depth texels too, the shader takes care of the odd ones
+    extent.width = std::bit_floor(std::max(depth_extent.width, 1u));
+    extent.height = std::bit_floor(std::max(depth_extent.height, 1u));
+    level_count = std::min((u32)std::bit_width(std::max(extent.width, extent.height)), DEPTH_PYRAMID_MAX_LEVELS);
+
+    VkImageCreateInfo img_info = vkinit::image_create_info(VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, {extent.width, extent.height, 1});
+    img_info.mipLevels = level_count;
+
+    VmaAllocationCreateInfo img_alloc_info = {};
+    img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    img_alloc_info.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VK_CHECK(vmaCreateImage(allocator, &img_info, &img_alloc_info, &image, &allocation, nullptr));
+
+    VkImageViewCreateInfo view_info = vkinit::imageview_create_info(VK_FORMAT_R32_SFLOAT, image, VK_IMAGE_ASPECT_COLOR_BIT);
+    view_info.subresourceRange.levelCount = level_count;
+    VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &view));
+
+    // The pyramid stays in GENERAL, it gets written and sampled level by level
+    sampled_index = heap->add_sampled_image(view, VK_IMAGE_LAYOUT_GENERAL);
+
+    for(u32 level = 0; level < level_count; level++) {
+        VkImageViewCreateInfo level_info = vkinit::imageview_create_info(VK_FORMAT_R32_SFLOAT, image, VK_IMAGE_ASPECT_COLOR_BIT);
+        level_info.subresourceRange.baseMipLevel = level;
+        VK_CHECK(vkCreateImageView(device, &level_info, nullptr, &level_views[level]));
+
+        level_indices[level] = heap->add_storage_image(level_views[level]);
+    }
+
+    VkSamplerCreateInfo sampler_info = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    sampler_info.pNext = nullptr;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.minLod = 0.f;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+
+    VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &sampler));
+    sampler_index = heap->add_sampler(sampler);
+}
+
+void vk_depth_pyramid::destroy() {
+    heap->remove_sampler(sampler_index);
+    heap->remove_sampled_image(sampled_index);
+
+    for(u32 level = 0; level < level_count; level++) {
+        heap->remove_storage_image(level_indices[level]);
+        vkDestroyImageView(device, level_views[level], nullptr);
+    }
+
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyImageView(device, view, nullptr);
+    vmaDestroyImage(allocator, image, allocation);
+}
+
+void vk_depth_pyramid::record_build(VkCommandBuffer cmd, VkPipeline pipeline, VkPipelineLayout layout, u32 depth_index, VkExtent2D draw_extent) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    VkMemoryBarrier2 level_barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    level_barrier.pNext = nullptr;
+    level_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    level_barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    level_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    level_barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+
+    VkDependencyInfo dep_info = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dep_info.pNext = nullptr;
+    dep_info.memoryBarrierCount = 1;
+    dep_info.pMemoryBarriers = &level_barrier;
+
+    for(u32 level = 0; level < level_count; level++) {
+        u32 level_width = std::max(extent.width >> level, 1u);
+        u32 level_height = std::max(extent.height >> level, 1u);
+
+        vk_depth_pyramid_push_constants push_constants{};
+        push_constants.target_size = glm::vec2(level_width, level_height);
+        push_constants.target_index = level_indices[level];
+        push_constants.sampler_index = sampler_index;
+
+        if(level == 0) {
+            push_constants.source_size = glm::vec2(draw_extent.width, draw_extent.height);
+            push_constants.source_index = depth_index;
+            push_constants.source_level = 0;
+        } else {
+            push_constants.source_size = glm::vec2(std::max(extent.width >> (level - 1), 1u), std::max(extent.height >> (level - 1), 1u));
+            push_constants.source_index = sampled_index;
+            push_constants.source_level = level - 1;
+        }
+
+        vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(vk_depth_pyramid_push_constants), &push_constants);
+        vkCmdDispatch(cmd, (level_width + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+                      (level_height + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE, 1);
+
+        // The next level reads this one
+        vkCmdPipelineBarrier2(cmd, &dep_info);
+    }
+}
@@ -0,0 +1,64 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_DEPTH_PYRAMID_H
+#define VK_DEPTH_PYRAMID_H
+
+#include "vk_descriptors.h"
+#include "vk_types.h"
+
+constexpr u32 DEPTH_PYRAMID_WORKGROUP_SIZE = 16; // Matches local_size_x/y in depth_pyramid.comp
+constexpr u32 DEPTH_PYRAMID_MAX_LEVELS = 16;
+
+struct vk_depth_pyramid_push_constants {
+    glm::vec2 source_size; // Texels of the source level that are covered, only part of the depth image is rendered to
+    glm::vec2 target_size;
+    u32 source_index; // Bindless sampled image, either the depth image or the pyramid itself
+    u32 source_level;
+    u32 sampler_index;
+    u32 target_index; // Bindless storage image of the level being written
+};
+
+// Mip chain of the depth buffer where every texel holds the farthest depth of the area it covers.
+// Occlusion tests pick the level where an object's screen rect covers at most 2x2 texels
+class vk_depth_pyramid {
+public:
+    /**
+     *  @brief Creates a power of two pyramid no bigger than depth_extent, with a storage view per level
+     */
+    void init(VkDevice device, VmaAllocator allocator, vk_bindless_heap* heap, VkExtent2D depth_extent);
+    void destroy();
+
+    /**
+     *  @brief Reduces the draw_extent part of the depth image into every level. The depth image has to be in
+     *  VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL and the pyramid in VK_IMAGE_LAYOUT_GENERAL, its old contents are overwritten
+     */
+    void record_build(VkCommandBuffer cmd, VkPipeline pipeline, VkPipelineLayout layout, u32 depth_index, VkExtent2D draw_extent);
+
+    VkImage get_image() const { return image; }
+    u32 get_sampled_index() const { return sampled_index; }
+    u32 get_sampler_index() const { return sampler_index; }
+    VkExtent2D get_extent() const { return extent; }
+    u32 get_level_count() const { return level_count; }
+
+private:
+    VkDevice device;
+    VmaAllocator allocator;
+    vk_bindless_heap* heap;
+
+    VkImage image;
+    VmaAllocation allocation;
+    VkExtent2D extent;
+    u32 level_count;
+
+    VkImageView view; // Every level, sampled
+    std::array<VkImageView, DEPTH_PYRAMID_MAX_LEVELS> level_views; // One level each, written as storage images
+    std::array<u32, DEPTH_PYRAMID_MAX_LEVELS> level_indices;
+    u32 sampled_index;
+
+    VkSampler sampler; // Nearest, clamped to the edge
+    u32 sampler_index;
+};
+
+#endif //VK_DEPTH_PYRAMID_H
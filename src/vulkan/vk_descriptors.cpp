@@ -4,45 +4,111 @@
 
 #include "vk_descriptors.h"
 
-void vk_descriptor_allocator::init_pool(VkDevice device, u32 max_sets, std::span<pool_size_ratio> pool_ratios) {
-    std::vector<VkDescriptorPoolSize> pool_sizes;
-    for (pool_size_ratio ratio : pool_ratios) {
-        pool_sizes.push_back(VkDescriptorPoolSize{
-            .type = ratio.type,
-            .descriptorCount = uint32_t(ratio.ratio * max_sets)
-        });
-    }
+#include <algorithm>
 
-    VkDescriptorPoolCreateInfo pool_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    pool_info.flags = 0;
-    pool_info.maxSets = max_sets;
-    pool_info.poolSizeCount = (uint32_t)pool_sizes.size();
-    pool_info.pPoolSizes = pool_sizes.data();
+// Pools grow by half each time, up to this many sets
+constexpr u32 DESCRIPTOR_POOL_MAX_SETS = 4092;
+
+void vk_descriptor_allocator::init(VkDevice device, u32 initial_sets, std::span<const pool_size_ratio> pool_ratios) {
+    ratios.assign(pool_ratios.begin(), pool_ratios.end());
 
-    vkCreateDescriptorPool(device, &pool_info, nullptr, &pool);
+    VkDescriptorPool new_pool = create_pool(device, initial_sets, pool_ratios);
+
+    // The next pool will be bigger
+    sets_per_pool = std::min((u32)(initial_sets * 1.5f), DESCRIPTOR_POOL_MAX_SETS);
+
+    ready_pools.push_back(new_pool);
 }
 
-void vk_descriptor_allocator::clear_descriptors(VkDevice device) {
-    vkResetDescriptorPool(device, pool, 0);
+void vk_descriptor_allocator::clear_pools(VkDevice device) {
+    for(VkDescriptorPool pool : ready_pools) {
+        VK_CHECK(vkResetDescriptorPool(device, pool, 0));
+    }
+
+    for(VkDescriptorPool pool : full_pools) {
+        VK_CHECK(vkResetDescriptorPool(device, pool, 0));
+        ready_pools.push_back(pool);
+    }
+
+    full_pools.clear();
 }
 
-void vk_descriptor_allocator::destroy_pool(VkDevice device) {
-    vkDestroyDescriptorPool(device, pool, nullptr);
+void vk_descriptor_allocator::destroy_pools(VkDevice device) {
+    for(VkDescriptorPool pool : ready_pools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+
+    for(VkDescriptorPool pool : full_pools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+
+    ready_pools.clear();
+    full_pools.clear();
 }
 
-VkDescriptorSet vk_descriptor_allocator::allocate(VkDevice device, VkDescriptorSetLayout layout) {
+VkDescriptorSet vk_descriptor_allocator::allocate(VkDevice device, VkDescriptorSetLayout layout, const void* p_next) {
+    VkDescriptorPool pool = get_pool(device);
+
     VkDescriptorSetAllocateInfo alloc_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    alloc_info.pNext = nullptr;
+    alloc_info.pNext = p_next;
     alloc_info.descriptorPool = pool;
     alloc_info.descriptorSetCount = 1;
     alloc_info.pSetLayouts = &layout;
 
     VkDescriptorSet ds;
-    VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &ds));
+    VkResult result = vkAllocateDescriptorSets(device, &alloc_info, &ds);
+
+    // The pool is used up, park it and retry once with a fresh one
+    if(result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        full_pools.push_back(pool);
+
+        pool = get_pool(device);
+        alloc_info.descriptorPool = pool;
+
+        VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &ds));
+    } else {
+        VK_CHECK(result);
+    }
 
+    ready_pools.push_back(pool);
     return ds;
 }
 
+VkDescriptorPool vk_descriptor_allocator::get_pool(VkDevice device) {
+    if(!ready_pools.empty()) {
+        VkDescriptorPool pool = ready_pools.back();
+        ready_pools.pop_back();
+
+        return pool;
+    }
+
+    VkDescriptorPool new_pool = create_pool(device, sets_per_pool, ratios);
+    sets_per_pool = std::min((u32)(sets_per_pool * 1.5f), DESCRIPTOR_POOL_MAX_SETS);
+
+    return new_pool;
+}
+
+VkDescriptorPool vk_descriptor_allocator::create_pool(VkDevice device, u32 set_count, std::span<const pool_size_ratio> pool_ratios) {
+    std::vector<VkDescriptorPoolSize> pool_sizes;
+    for (pool_size_ratio ratio : pool_ratios) {
+        pool_sizes.push_back(VkDescriptorPoolSize{
+            .type = ratio.type,
+            .descriptorCount = std::max(uint32_t(ratio.ratio * set_count), 1u)
+        });
+    }
+
+    VkDescriptorPoolCreateInfo pool_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.flags = 0;
+    pool_info.maxSets = set_count;
+    pool_info.poolSizeCount = (uint32_t)pool_sizes.size();
+    pool_info.pPoolSizes = pool_sizes.data();
+
+    VkDescriptorPool new_pool;
+    VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &new_pool));
+
+    return new_pool;
+}
+
 void vk_descriptor_layout_builder::add_binding(u32 binding, VkDescriptorType type) {
     VkDescriptorSetLayoutBinding newbind {};
     newbind.binding = binding;
@@ -72,4 +138,184 @@ VkDescriptorSetLayout vk_descriptor_layout_builder::build(VkDevice device, VkSha
     VK_CHECK(vkCreateDescriptorSetLayout(device, &info, nullptr, &set));
 
     return set;
-}
\ No newline at end of file
+}
+
+u32 vk_bindless_index_allocator::allocate() {
+    if(!free_indices.empty()) {
+        u32 index = free_indices.back();
+        free_indices.pop_back();
+
+        return index;
+    }
+
+    if(next >= capacity) {
+        LOG_THROW("Bindless heap: out of descriptors");
+    }
+
+    return next++;
+}
+
+void vk_bindless_index_allocator::free(u32 index) {
+    free_indices.push_back(index);
+}
+
+void vk_bindless_heap::init(VkDevice device, VkPhysicalDevice gpu, u32 max_sampled_images, u32 max_storage_images, u32 max_samplers) {
+    this->device = device;
+
+    VkPhysicalDeviceVulkan12Properties vk12_properties = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    properties.pNext = &vk12_properties;
+    vkGetPhysicalDeviceProperties2(gpu, &properties);
+
+    // A single stage can see the whole heap, so the per stage limits apply as well
+    max_sampled_images = std::min({max_sampled_images, vk12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                   vk12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    max_storage_images = std::min({max_storage_images, vk12_properties.maxDescriptorSetUpdateAfterBindStorageImages,
+                                   vk12_properties.maxPerStageDescriptorUpdateAfterBindStorageImages});
+    max_samplers = std::min({max_samplers, vk12_properties.maxDescriptorSetUpdateAfterBindSamplers,
+                             vk12_properties.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+    // The three arrays also share one per stage budget, together with the color attachments of fragment shaders.
+    // When they don't fit, each gives up the same fraction of its size
+    u32 max_color_attachments = properties.properties.limits.maxColorAttachments;
+    u32 resource_budget = vk12_properties.maxPerStageUpdateAfterBindResources - std::min(max_color_attachments, vk12_properties.maxPerStageUpdateAfterBindResources);
+    u64 resource_count = (u64)max_sampled_images + max_storage_images + max_samplers;
+    if(resource_count > resource_budget) {
+        max_sampled_images = std::max((u32)((u64)max_sampled_images * resource_budget / resource_count), 1u);
+        max_storage_images = std::max((u32)((u64)max_storage_images * resource_budget / resource_count), 1u);
+        max_samplers = std::max((u32)((u64)max_samplers * resource_budget / resource_count), 1u);
+    }
+
+    sampled_images = { max_sampled_images, 0, {} };
+    storage_images = { max_storage_images, 0, {} };
+    samplers = { max_samplers, 0, {} };
+
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[0] = { BINDLESS_SAMPLED_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, max_sampled_images, VK_SHADER_STAGE_ALL, nullptr };
+    bindings[1] = { BINDLESS_STORAGE_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, max_storage_images, VK_SHADER_STAGE_ALL, nullptr };
+    bindings[2] = { BINDLESS_SAMPLER_BINDING, VK_DESCRIPTOR_TYPE_SAMPLER, max_samplers, VK_SHADER_STAGE_ALL, nullptr };
+
+    // Slots that were never written are fine as long as no shader reads them, and writes don't have to wait for the frames using the set
+    VkDescriptorBindingFlags binding_flag = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    std::array<VkDescriptorBindingFlags, 3> binding_flags = { binding_flag, binding_flag, binding_flag };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    flags_info.pNext = nullptr;
+    flags_info.bindingCount = (u32)binding_flags.size();
+    flags_info.pBindingFlags = binding_flags.data();
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layout_info.pNext = &flags_info;
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = (u32)bindings.size();
+    layout_info.pBindings = bindings.data();
+
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &set_layout));
+
+    std::array<VkDescriptorPoolSize, 3> pool_sizes = {{
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, max_sampled_images },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, max_storage_images },
+        { VK_DESCRIPTOR_TYPE_SAMPLER, max_samplers },
+    }};
+
+    VkDescriptorPoolCreateInfo pool_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = (u32)pool_sizes.size();
+    pool_info.pPoolSizes = pool_sizes.data();
+
+    VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &pool));
+
+    VkDescriptorSetAllocateInfo alloc_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    alloc_info.pNext = nullptr;
+    alloc_info.descriptorPool = pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &set_layout;
+
+    VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &set));
+
+    // One layout for every pipeline, binding the heap once stays valid across pipeline switches
+    VkPushConstantRange push_constant{};
+    push_constant.stageFlags = VK_SHADER_STAGE_ALL;
+    push_constant.offset = 0;
+    push_constant.size = BINDLESS_PUSH_CONSTANT_SIZE;
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipeline_layout_info.pNext = nullptr;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant;
+
+    VK_CHECK(vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &pipeline_layout));
+}
+
+void vk_bindless_heap::destroy() {
+    vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+}
+
+u32 vk_bindless_heap::add_sampled_image(VkImageView view, VkImageLayout layout) {
+    u32 index = sampled_images.allocate();
+    update_sampled_image(index, view, layout);
+
+    return index;
+}
+
+u32 vk_bindless_heap::add_storage_image(VkImageView view) {
+    u32 index = storage_images.allocate();
+    update_storage_image(index, view);
+
+    return index;
+}
+
+u32 vk_bindless_heap::add_sampler(VkSampler sampler) {
+    u32 index = samplers.allocate();
+
+    VkDescriptorImageInfo sampler_info{};
+    sampler_info.sampler = sampler;
+
+    VkWriteDescriptorSet write = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.pNext = nullptr;
+    write.dstSet = set;
+    write.dstBinding = BINDLESS_SAMPLER_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    write.pImageInfo = &sampler_info;
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    return index;
+}
+
+void vk_bindless_heap::update_sampled_image(u32 index, VkImageView view, VkImageLayout layout) {
+    write_image(BINDLESS_SAMPLED_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, index, view, layout);
+}
+
+void vk_bindless_heap::update_storage_image(u32 index, VkImageView view) {
+    write_image(BINDLESS_STORAGE_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, index, view, VK_IMAGE_LAYOUT_GENERAL);
+}
+
+void vk_bindless_heap::bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point) const {
+    vkCmdBindDescriptorSets(cmd, bind_point, pipeline_layout, 0, 1, &set, 0, nullptr);
+}
+
+void vk_bindless_heap::write_image(u32 binding, VkDescriptorType type, u32 index, VkImageView view, VkImageLayout layout) {
+    VkDescriptorImageInfo img_info{};
+    img_info.imageLayout = layout;
+    img_info.imageView = view;
+
+    VkWriteDescriptorSet write = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.pNext = nullptr;
+    write.dstSet = set;
+    write.dstBinding = binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pImageInfo = &img_info;
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
@@ -7,19 +7,28 @@
 
 #include "vk_types.h"
 
+// Allocates from a list of pools and creates a bigger pool whenever the current ones run out.
+// Resetting hands every set back at once, so transient sets cost a pool allocation instead of individual frees
 struct vk_descriptor_allocator {
     struct pool_size_ratio {
         VkDescriptorType type;
         float ratio;
     };
 
-    VkDescriptorPool pool;
+    void init(VkDevice device, u32 initial_sets, std::span<const pool_size_ratio> pool_ratios);
+    void clear_pools(VkDevice device);
+    void destroy_pools(VkDevice device);
+
+    VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout, const void* p_next = nullptr);
 
-    void init_pool(VkDevice device, u32 max_sets, std::span<pool_size_ratio> pool_ratios);
-    void clear_descriptors(VkDevice device);
-    void destroy_pool(VkDevice device);
+private:
+    VkDescriptorPool get_pool(VkDevice device);
+    VkDescriptorPool create_pool(VkDevice device, u32 set_count, std::span<const pool_size_ratio> pool_ratios);
 
-    VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
+    std::vector<pool_size_ratio> ratios;
+    std::vector<VkDescriptorPool> full_pools; // Ran out at least once, only reused after a reset
+    std::vector<VkDescriptorPool> ready_pools;
+    u32 sets_per_pool;
 };
 
 struct vk_descriptor_layout_builder {
@@ -31,4 +40,69 @@ struct vk_descriptor_layout_builder {
     VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shader_stages);
 };
 
+// Bindings of the bindless heap, shaders declare them as unsized arrays in set 0
+constexpr u32 BINDLESS_SAMPLED_IMAGE_BINDING = 0;
+constexpr u32 BINDLESS_STORAGE_IMAGE_BINDING = 1;
+constexpr u32 BINDLESS_SAMPLER_BINDING = 2;
+
+// Every pipeline on the bindless layout shares one push constant range of the guaranteed minimum size
+constexpr u32 BINDLESS_PUSH_CONSTANT_SIZE = 128;
+
+// Hands out stable indices into one array of the bindless heap, freed indices get reused first
+struct vk_bindless_index_allocator {
+    u32 capacity;
+    u32 next;
+    std::vector<u32> free_indices;
+
+    u32 allocate();
+    void free(u32 index);
+};
+
+// One global update-after-bind descriptor set holding every image and sampler. Shaders index into its arrays,
+// so a command buffer binds it once per bind point instead of binding a set per draw
+class vk_bindless_heap {
+public:
+    /**
+     *  @brief Creates the heap, the counts get clamped to the update-after-bind limits of the gpu
+     */
+    void init(VkDevice device, VkPhysicalDevice gpu, u32 max_sampled_images, u32 max_storage_images, u32 max_samplers);
+    void destroy();
+
+    u32 add_sampled_image(VkImageView view, VkImageLayout layout);
+    u32 add_storage_image(VkImageView view);
+    u32 add_sampler(VkSampler sampler);
+
+    /**
+     *  @brief Points an index at a different resource. Only safe when no pending command buffer reads that index
+     */
+    void update_sampled_image(u32 index, VkImageView view, VkImageLayout layout);
+    void update_storage_image(u32 index, VkImageView view);
+
+    /**
+     *  @brief Gives the index back for reuse, the gpu has to be done with it. Use vk_renderer::retire for that
+     */
+    void remove_sampled_image(u32 index) { sampled_images.free(index); }
+    void remove_storage_image(u32 index) { storage_images.free(index); }
+    void remove_sampler(u32 index) { samplers.free(index); }
+
+    void bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point) const;
+
+    VkDescriptorSetLayout get_set_layout() const { return set_layout; }
+    VkPipelineLayout get_pipeline_layout() const { return pipeline_layout; }
+
+private:
+    void write_image(u32 binding, VkDescriptorType type, u32 index, VkImageView view, VkImageLayout layout);
+
+    VkDevice device;
+
+    VkDescriptorPool pool;
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorSet set;
+    VkPipelineLayout pipeline_layout;
+
+    vk_bindless_index_allocator sampled_images;
+    vk_bindless_index_allocator storage_images;
+    vk_bindless_index_allocator samplers;
+};
+
 #endif //VK_DESCRIPTORS_H
@@ -0,0 +1,247 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_effect_registry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+struct effect_parameter_type_info {
+    const char* name;
+    u32 component_count;
+    u32 alignment; // std430, vec3 aligns like vec4 but only takes 12 bytes
+    bool is_float;
+};
+
+// Indexed by vk_effect_parameter_type
+static constexpr effect_parameter_type_info EFFECT_PARAMETER_TYPE_INFOS[EFFECT_PARAMETER_COUNT] = {
+    { "float", 1, 4, true },
+    { "vec2", 2, 8, true },
+    { "vec3", 3, 16, true },
+    { "vec4", 4, 16, true },
+    { "color3", 3, 16, true },
+    { "color4", 4, 16, true },
+    { "int", 1, 4, false },
+    { "uint", 1, 4, false },
+};
+
+// Indexed by vk_effect_stage
+static constexpr const char* EFFECT_STAGE_NAMES[EFFECT_STAGE_COUNT] = { "background", "post" };
+
+void vk_effect_registry::load(const std::string& manifest_path, const std::string& shader_directory) {
+    std::ifstream file(manifest_path);
+    if(!file.is_open()) {
+        LOG_THROW("Failed to open effect manifest " + manifest_path);
+    }
+
+    effects.clear();
+    for(auto& stage : stages) {
+        stage.clear();
+    }
+
+    std::string effect_location;
+    std::string text;
+    u32 line_number = 0;
+
+    while(std::getline(file, text)) {
+        line_number++;
+        std::string location = manifest_path + ":" + std::to_string(line_number);
+
+        size_t comment = text.find('#');
+        if(comment != std::string::npos) {
+            text.resize(comment);
+        }
+
+        std::istringstream line(text);
+        std::string statement;
+        if(!(line >> statement)) continue;
+
+        if(statement == "effect") {
+            if(!effects.empty()) {
+                finish_effect(effect_location);
+            }
+
+            vk_compute_effect effect{};
+            std::string stage;
+            if(!(line >> effect.name >> stage)) {
+                LOG_THROW(location + ": expected effect <name> <stage>");
+            }
+
+            if(find(effect.name) != ~0u) {
+                LOG_THROW(location + ": effect " + effect.name + " is declared twice");
+            }
+
+            auto stage_name = std::find_if(std::begin(EFFECT_STAGE_NAMES), std::end(EFFECT_STAGE_NAMES), [&](const char* name) { return stage == name; });
+            if(stage_name == std::end(EFFECT_STAGE_NAMES)) {
+                LOG_THROW(location + ": unknown effect stage " + stage);
+            }
+
+            effect.stage = (vk_effect_stage)(stage_name - std::begin(EFFECT_STAGE_NAMES));
+            effect.enabled = true;
+            effect.pipeline = VK_NULL_HANDLE;
+            effect.data_size = sizeof(vk_gpu_effect_header);
+
+            effects.push_back(std::move(effect));
+            effect_location = location;
+            continue;
+        }
+
+        if(effects.empty()) {
+            LOG_THROW(location + ": " + statement + " outside of an effect");
+        }
+
+        vk_compute_effect& effect = effects.back();
+
+        if(statement == "shader") {
+            std::string shader;
+            if(!(line >> shader)) {
+                LOG_THROW(location + ": expected shader <file>");
+            }
+
+            effect.shader_path = shader_directory + "/" + shader;
+        } else if(statement == "workgroup") {
+            if(!(line >> effect.workgroup_size.width >> effect.workgroup_size.height)) {
+                LOG_THROW(location + ": expected workgroup <x> <y>");
+            }
+        } else if(statement == "param") {
+            parse_parameter(effect, line, location);
+        } else if(statement == "reads") {
+            std::string resource;
+            line >> resource;
+
+            if(resource != "depth") {
+                LOG_THROW(location + ": effects can only read depth, not " + resource);
+            }
+
+            effect.reads_depth = true;
+        } else if(statement == "disabled") {
+            if(effect.stage != EFFECT_STAGE_POST) {
+                LOG_THROW(location + ": only post effects can be disabled");
+            }
+
+            effect.enabled = false;
+        } else {
+            LOG_THROW(location + ": unknown statement " + statement);
+        }
+    }
+
+    if(!effects.empty()) {
+        finish_effect(effect_location);
+    }
+
+    if(stages[EFFECT_STAGE_BACKGROUND].empty()) {
+        LOG_THROW(manifest_path + ": there has to be at least one background effect");
+    }
+}
+
+void vk_effect_registry::parse_parameter(vk_compute_effect& effect, std::istringstream& line, const std::string& location) {
+    vk_effect_parameter parameter{};
+    std::string type;
+    if(!(line >> parameter.name >> type)) {
+        LOG_THROW(location + ": expected param <name> <type> <values...>");
+    }
+
+    for(const vk_effect_parameter& other : effect.parameters) {
+        if(other.name == parameter.name) {
+            LOG_THROW(location + ": parameter " + parameter.name + " is declared twice");
+        }
+    }
+
+    auto type_info = std::find_if(std::begin(EFFECT_PARAMETER_TYPE_INFOS), std::end(EFFECT_PARAMETER_TYPE_INFOS),
+                                  [&](const effect_parameter_type_info& info) { return type == info.name; });
+    if(type_info == std::end(EFFECT_PARAMETER_TYPE_INFOS)) {
+        LOG_THROW(location + ": unknown parameter type " + type);
+    }
+
+    parameter.type = (vk_effect_parameter_type)(type_info - std::begin(EFFECT_PARAMETER_TYPE_INFOS));
+    parameter.component_count = type_info->component_count;
+    parameter.offset = (effect.data_size + type_info->alignment - 1) / type_info->alignment * type_info->alignment;
+
+    u32 size = parameter.component_count * 4;
+    if(parameter.offset + size > effect.data.size()) {
+        LOG_THROW(location + ": parameter " + parameter.name + " doesn't fit into the " + std::to_string(effect.data.size()) + " bytes of push constants");
+    }
+
+    // Every component is 4 bytes, the type only decides how the text is read
+    for(u32 i = 0; i < parameter.component_count; i++) {
+        u8* value = effect.data.data() + parameter.offset + i * 4;
+        bool read;
+
+        if(type_info->is_float) {
+            f32 component;
+            read = (bool)(line >> component);
+            std::memcpy(value, &component, 4);
+        } else if(parameter.type == EFFECT_PARAMETER_INT) {
+            i32 component;
+            read = (bool)(line >> component);
+            std::memcpy(value, &component, 4);
+        } else {
+            u32 component;
+            read = (bool)(line >> component);
+            std::memcpy(value, &component, 4);
+        }
+
+        if(!read) {
+            LOG_THROW(location + ": parameter " + parameter.name + " needs " + std::to_string(parameter.component_count) + " values");
+        }
+    }
+
+    std::string range;
+    if(line >> range) {
+        if(range != "range" || !(line >> parameter.min >> parameter.max)) {
+            LOG_THROW(location + ": expected range <min> <max> after the values of " + parameter.name);
+        }
+
+        parameter.has_range = true;
+    }
+
+    effect.data_size = parameter.offset + size;
+    effect.parameters.push_back(std::move(parameter));
+}
+
+void vk_effect_registry::finish_effect(const std::string& location) {
+    const vk_compute_effect& effect = effects.back();
+
+    if(effect.shader_path.empty()) {
+        LOG_THROW(location + ": effect " + effect.name + " has no shader");
+    }
+
+    if(effect.workgroup_size.width == 0 || effect.workgroup_size.height == 0) {
+        LOG_THROW(location + ": effect " + effect.name + " has no workgroup size");
+    }
+
+    stages[effect.stage].push_back((u32)effects.size() - 1);
+}
+
+void vk_effect_registry::destroy(VkDevice device) {
+    for(vk_compute_effect& effect : effects) {
+        vkDestroyPipeline(device, effect.pipeline, nullptr);
+        effect.pipeline = VK_NULL_HANDLE;
+    }
+}
+
+void vk_effect_registry::record(VkCommandBuffer cmd, VkPipelineLayout layout, u32 effect_index, const vk_effect_inputs& inputs) const {
+    const vk_compute_effect& effect = effects[effect_index];
+
+    std::array<u8, BINDLESS_PUSH_CONSTANT_SIZE> push_constants = effect.data;
+
+    vk_gpu_effect_header header{ inputs.target_index, inputs.extent.width, inputs.extent.height, inputs.depth_index, inputs.sampler_index, inputs.frame_number };
+    std::memcpy(push_constants.data(), &header, sizeof(header));
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipeline);
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, effect.data_size, push_constants.data());
+
+    // Enough workgroups to cover the extent, the shaders skip the invocations past its edges
+    vkCmdDispatch(cmd, (inputs.extent.width + effect.workgroup_size.width - 1) / effect.workgroup_size.width,
+                  (inputs.extent.height + effect.workgroup_size.height - 1) / effect.workgroup_size.height, 1);
+}
+
+u32 vk_effect_registry::find(const std::string& name) const {
+    for(u32 i = 0; i < effects.size(); i++) {
+        if(effects[i].name == name) return i;
+    }
+
+    return ~0u;
+}
@@ -0,0 +1,136 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_EFFECT_REGISTRY_H
+#define VK_EFFECT_REGISTRY_H
+
+#include <sstream>
+
+#include "vk_descriptors.h"
+#include "vk_types.h"
+
+// When in the frame an effect runs
+enum vk_effect_stage : u32 {
+    EFFECT_STAGE_BACKGROUND = 0, // Fills the draw image before the geometry, one of them runs per frame
+    EFFECT_STAGE_POST,           // Works on the draw image in place after the geometry, every enabled one runs in manifest order
+    EFFECT_STAGE_COUNT,
+};
+
+enum vk_effect_parameter_type : u32 {
+    EFFECT_PARAMETER_FLOAT = 0,
+    EFFECT_PARAMETER_VEC2,
+    EFFECT_PARAMETER_VEC3,
+    EFFECT_PARAMETER_VEC4,
+    EFFECT_PARAMETER_COLOR3, // vec3 edited with a color picker
+    EFFECT_PARAMETER_COLOR4,
+    EFFECT_PARAMETER_INT,
+    EFFECT_PARAMETER_UINT,
+    EFFECT_PARAMETER_COUNT,
+};
+
+// A value in the push constants of an effect, laid out with the std430 rules of the shader's push_constant block
+struct vk_effect_parameter {
+    std::string name;
+    vk_effect_parameter_type type;
+    u32 offset; // Bytes from the start of the push constants
+    u32 component_count;
+
+    // Slider range of the parameter, editors fall back to a plain input field without one
+    bool has_range;
+    f32 min;
+    f32 max;
+};
+
+// Layout matches the six uints starting the push_constant block of every effect shader. The parameters follow right after it
+// at offset 24, aligned by their own std430 rules, so a leading float starts at 24 and a leading vec3 or vec4 at 32
+struct vk_gpu_effect_header {
+    u32 target_index; // Bindless storage image the effect writes into
+    u32 width; // Part of the image the effect covers, the draw extent
+    u32 height;
+    u32 depth_index; // Bindless sampled depth image, only set for effects that read depth
+    u32 sampler_index; // Linear clamped sampler
+    u32 frame_number; // Animates procedural effects
+};
+
+static_assert(sizeof(vk_gpu_effect_header) == 24);
+
+// What an effect is recorded against, filled in by the pass it runs in
+struct vk_effect_inputs {
+    u32 target_index;
+    VkExtent2D extent;
+    u32 depth_index;
+    u32 sampler_index;
+    u32 frame_number;
+};
+
+struct vk_compute_effect {
+    std::string name;
+    std::string shader_path;
+    vk_effect_stage stage;
+    VkExtent2D workgroup_size; // Specialization constants 0 and 1 of the effect's shader, its local_size_x_id and local_size_y_id
+
+    // What the effect reads besides its target, the render graph orders it after the writers
+    bool reads_depth;
+
+    bool enabled; // Post effects can be switched off, background effects get picked instead
+
+    VkPipeline pipeline; // VK_NULL_HANDLE while it is compiling
+
+    std::vector<vk_effect_parameter> parameters;
+    std::array<u8, BINDLESS_PUSH_CONSTANT_SIZE> data; // The push constants, the header gets written when the effect is recorded
+    u32 data_size;
+};
+
+// Compute effects described by a manifest instead of code. Every effect names its shader, workgroup size, the parameters of its
+// push constants with their defaults and what it reads, so new background and post effects only need a shader and a manifest entry.
+//
+// The manifest is a text file, one statement per line and # starting a comment:
+//
+//  effect <name> <background|post>   starts an effect, the statements below describe it
+//  shader <file>                     .spv file, relative to the shader directory
+//  workgroup <x> <y>                 local size of the shader, which has to declare local_size_x_id = 0 and local_size_y_id = 1
+//  param <name> <type> <values...> [range <min> <max>]
+//                                    type is float, vec2, vec3, vec4, color3, color4, int or uint, one value per component
+//  reads depth                       the effect samples the depth image through depth_index
+//  disabled                          post effects only, the effect starts switched off
+class vk_effect_registry {
+public:
+    /**
+     *  @brief Parses the manifest, throws on statements it doesn't understand and on parameters that don't fit the push constants
+     */
+    void load(const std::string& manifest_path, const std::string& shader_directory);
+
+    /**
+     *  @brief Destroys the pipelines of every effect, the gpu has to be done with them
+     */
+    void destroy(VkDevice device);
+
+    /**
+     *  @brief Binds the effect's pipeline and dispatches enough workgroups to cover inputs.extent. The bindless heap has to be bound
+     */
+    void record(VkCommandBuffer cmd, VkPipelineLayout layout, u32 effect, const vk_effect_inputs& inputs) const;
+
+    vk_compute_effect& get_effect(u32 effect) { return effects[effect]; }
+    const vk_compute_effect& get_effect(u32 effect) const { return effects[effect]; }
+    u32 get_effect_count() const { return (u32)effects.size(); }
+
+    /**
+     *  @brief Indices of the stage's effects, in manifest order
+     */
+    std::span<const u32> get_stage(vk_effect_stage stage) const { return stages[stage]; }
+
+    /**
+     *  @brief Index of the named effect, ~0u when there is none
+     */
+    u32 find(const std::string& name) const;
+
+private:
+    void parse_parameter(vk_compute_effect& effect, std::istringstream& line, const std::string& location);
+    void finish_effect(const std::string& location);
+
+    std::vector<vk_compute_effect> effects;
+    std::array<std::vector<u32>, EFFECT_STAGE_COUNT> stages;
+};
+
+#endif //VK_EFFECT_REGISTRY_H
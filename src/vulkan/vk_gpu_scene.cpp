@@ -0,0 +1,237 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_gpu_scene.h"
+
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_access.hpp>
+
+void vk_gpu_scene::init(VkDevice device, VmaAllocator allocator, vk_uploader* uploader, u32 frame_count, u32 max_objects, u32 max_vertices, u32 max_indices) {
+    this->device = device;
+    this->allocator = allocator;
+    this->uploader = uploader;
+    this->max_objects = max_objects;
+    this->max_vertices = max_vertices;
+    this->max_indices = max_indices;
+
+    object_buffer = create_buffer(max_objects * sizeof(vk_gpu_object), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY, &object_buffer_address);
+    visibility_buffer = create_buffer(max_objects * sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VMA_MEMORY_USAGE_GPU_ONLY, &visibility_buffer_address);
+    vertex_buffer = create_buffer(max_vertices * sizeof(vk_vertex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY, &vertex_buffer_address);
+    index_buffer = create_buffer(max_indices * sizeof(u32), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+
+    frames.resize(frame_count);
+    for(auto& frame : frames) {
+        frame.draw_buffer = create_buffer(2 * max_objects * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                          VMA_MEMORY_USAGE_GPU_ONLY, &frame.draw_buffer_address);
+        frame.count_buffer = create_buffer(2 * sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VMA_MEMORY_USAGE_GPU_ONLY, &frame.count_buffer_address);
+
+        // The slot is idle whenever its frame gets recorded, so the cpu writes the parameters straight into it
+        frame.params_buffer = create_buffer(sizeof(vk_gpu_cull_params), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &frame.params_buffer_address);
+    }
+}
+
+void vk_gpu_scene::destroy() {
+    for(auto& frame : frames) {
+        vmaDestroyBuffer(allocator, frame.draw_buffer.buffer, frame.draw_buffer.allocation);
+        vmaDestroyBuffer(allocator, frame.count_buffer.buffer, frame.count_buffer.allocation);
+        vmaDestroyBuffer(allocator, frame.params_buffer.buffer, frame.params_buffer.allocation);
+    }
+
+    vmaDestroyBuffer(allocator, object_buffer.buffer, object_buffer.allocation);
+    vmaDestroyBuffer(allocator, visibility_buffer.buffer, visibility_buffer.allocation);
+    vmaDestroyBuffer(allocator, vertex_buffer.buffer, vertex_buffer.allocation);
+    vmaDestroyBuffer(allocator, index_buffer.buffer, index_buffer.allocation);
+}
+
+vk_gpu_scene_mesh vk_gpu_scene::add_mesh(std::span<const u32> indices, std::span<const vk_vertex> vertices) {
+    if(vertex_count + vertices.size() > max_vertices || index_count + indices.size() > max_indices) {
+        LOG_THROW("GPU scene: out of space for mesh data");
+    }
+
+    vk_gpu_scene_mesh mesh{};
+    mesh.first_index = index_count;
+    mesh.index_count = (u32)indices.size();
+    mesh.vertex_offset = (i32)vertex_count;
+
+    // Sphere around the center of the bounding box, not the tightest one but good enough for culling
+    glm::vec3 min_position = vertices.empty() ? glm::vec3(0.f) : vertices[0].position;
+    glm::vec3 max_position = min_position;
+    for(const vk_vertex& vertex : vertices) {
+        min_position = glm::min(min_position, vertex.position);
+        max_position = glm::max(max_position, vertex.position);
+    }
+
+    glm::vec3 center = (min_position + max_position) * 0.5f;
+
+    f32 radius = 0.f;
+    for(const vk_vertex& vertex : vertices) {
+        radius = std::max(radius, glm::length(vertex.position - center));
+    }
+
+    mesh.bounding_sphere = glm::vec4(center, radius);
+
+    // Indices stay relative to the mesh, the draw command's vertex offset moves them into the shared vertex buffer
+    uploader->upload_buffer(vertex_buffer.buffer, vertex_count * sizeof(vk_vertex), vertices.data(), vertices.size_bytes());
+    uploader->upload_buffer(index_buffer.buffer, index_count * sizeof(u32), indices.data(), indices.size_bytes());
+
+    vertex_count += (u32)vertices.size();
+    index_count += (u32)indices.size();
+
+    return mesh;
+}
+
+u32 vk_gpu_scene::add_object(const vk_gpu_scene_mesh& mesh, const glm::mat4& world_matrix) {
+    if(objects.size() >= max_objects) {
+        LOG_THROW("GPU scene: too many objects");
+    }
+
+    u32 object = (u32)objects.size();
+    objects.push_back({ world_matrix, mesh.bounding_sphere, mesh.first_index, mesh.index_count, mesh.vertex_offset, 0 });
+
+    set_transform(object, world_matrix);
+
+    return object;
+}
+
+void vk_gpu_scene::set_transform(u32 object, const glm::mat4& world_matrix) {
+    objects[object].world_matrix = world_matrix;
+
+    // Changes are uploaded as one contiguous range, which is what moving a batch of neighbouring objects produces anyway
+    if(dirty_begin == dirty_end) {
+        dirty_begin = object;
+        dirty_end = object + 1;
+    } else {
+        dirty_begin = std::min(dirty_begin, object);
+        dirty_end = std::max(dirty_end, object + 1);
+    }
+}
+
+void vk_gpu_scene::sync() {
+    if(dirty_begin == dirty_end) return;
+
+    uploader->upload_buffer(object_buffer.buffer, dirty_begin * sizeof(vk_gpu_object), &objects[dirty_begin], (dirty_end - dirty_begin) * sizeof(vk_gpu_object));
+
+    dirty_begin = 0;
+    dirty_end = 0;
+}
+
+void vk_gpu_scene::record_cull(VkCommandBuffer cmd, u32 frame_index, vk_gpu_cull_phase phase, VkPipeline pipeline, VkPipelineLayout layout,
+                               const glm::mat4& view_projection, const vk_gpu_cull_occlusion& occlusion) {
+    frame_buffers& frame = frames[frame_index];
+
+    if(phase != GPU_CULL_PHASE_LATE) {
+        // Nothing was visible before the first frame, so it draws everything in the late phase
+        if(!visibility_cleared) {
+            vkCmdFillBuffer(cmd, visibility_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+            visibility_cleared = true;
+        }
+
+        // The shader appends the visible objects with an atomic counter per list, which starts at zero every frame
+        vkCmdFillBuffer(cmd, frame.count_buffer.buffer, 0, 2 * sizeof(u32), 0);
+
+        // Gribb/Hartmann plane extraction, with vulkan's 0..1 depth range the near plane is just the third row
+        glm::vec4 row0 = glm::row(view_projection, 0);
+        glm::vec4 row1 = glm::row(view_projection, 1);
+        glm::vec4 row2 = glm::row(view_projection, 2);
+        glm::vec4 row3 = glm::row(view_projection, 3);
+
+        vk_gpu_cull_params& params = *(vk_gpu_cull_params*)frame.params_buffer.info.pMappedData;
+        params.view_projection = view_projection;
+        params.frustum_planes[0] = row3 + row0;
+        params.frustum_planes[1] = row3 - row0;
+        params.frustum_planes[2] = row3 + row1;
+        params.frustum_planes[3] = row3 - row1;
+        params.frustum_planes[4] = row2;
+        params.frustum_planes[5] = row3 - row2;
+
+        // Normalized so the plane distance can be compared against the sphere radius
+        for(glm::vec4& plane : params.frustum_planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        params.pyramid_size = glm::vec2(occlusion.pyramid_extent.width, occlusion.pyramid_extent.height);
+        params.pyramid_index = occlusion.pyramid_index;
+        params.sampler_index = occlusion.sampler_index;
+        params.pyramid_levels = occlusion.level_count;
+    }
+
+    // Covers the clears above and last frame's late phase writing the visibility flags
+    VkMemoryBarrier2 cull_barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    cull_barrier.pNext = nullptr;
+    cull_barrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    cull_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    cull_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    cull_barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+    VkDependencyInfo dep_info = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dep_info.pNext = nullptr;
+    dep_info.memoryBarrierCount = 1;
+    dep_info.pMemoryBarriers = &cull_barrier;
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    vk_gpu_cull_push_constants push_constants{};
+    push_constants.params = frame.params_buffer_address;
+    push_constants.object_buffer = object_buffer_address;
+    push_constants.visibility_buffer = visibility_buffer_address;
+    push_constants.draw_buffer = frame.draw_buffer_address;
+    push_constants.count_buffer = frame.count_buffer_address;
+    push_constants.object_count = (u32)objects.size();
+    push_constants.phase = phase;
+    push_constants.draw_capacity = max_objects;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(vk_gpu_cull_push_constants), &push_constants);
+    vkCmdDispatch(cmd, (push_constants.object_count + GPU_CULL_WORKGROUP_SIZE - 1) / GPU_CULL_WORKGROUP_SIZE, 1, 1);
+}
+
+void vk_gpu_scene::record_draw(VkCommandBuffer cmd, u32 frame_index, vk_gpu_cull_phase phase, VkPipeline pipeline, VkPipelineLayout layout, const glm::mat4& view_projection) {
+    frame_buffers& frame = frames[frame_index];
+
+    vk_gpu_indirect_push_constants push_constants{};
+    push_constants.view_projection = view_projection;
+    push_constants.object_buffer = object_buffer_address;
+    push_constants.vertex_buffer = vertex_buffer_address;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(vk_gpu_indirect_push_constants), &push_constants);
+    vkCmdBindIndexBuffer(cmd, index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    // firstInstance of every command is the object index, the vertex shader looks the object up through gl_InstanceIndex
+    u32 list = phase == GPU_CULL_PHASE_LATE ? 1 : 0;
+    vkCmdDrawIndexedIndirectCount(cmd, frame.draw_buffer.buffer, list * max_objects * sizeof(VkDrawIndexedIndirectCommand),
+                                  frame.count_buffer.buffer, list * sizeof(u32), (u32)objects.size(), sizeof(VkDrawIndexedIndirectCommand));
+}
+
+vk_allocated_buffer vk_gpu_scene::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VkDeviceAddress* address) {
+    VkBufferCreateInfo buffer_info = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.pNext = nullptr;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+
+    if(address) {
+        buffer_info.usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    }
+
+    // Mapped on creation when it is host visible
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = memory_usage;
+    alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    vk_allocated_buffer buffer;
+    VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer.buffer, &buffer.allocation, &buffer.info));
+
+    if(address) {
+        VkBufferDeviceAddressInfo address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer.buffer };
+        *address = vkGetBufferDeviceAddress(device, &address_info);
+    }
+
+    return buffer;
+}
@@ -0,0 +1,157 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_GPU_SCENE_H
+#define VK_GPU_SCENE_H
+
+#include "vk_types.h"
+#include "vk_uploader.h"
+
+constexpr u32 GPU_CULL_WORKGROUP_SIZE = 64; // Matches local_size_x in cull.comp
+
+// Layout matches the Object struct in cull.comp and indirect_mesh.vert
+struct vk_gpu_object {
+    glm::mat4 world_matrix;
+    glm::vec4 bounding_sphere; // Object space center in xyz, radius in w
+    u32 first_index;
+    u32 index_count;
+    i32 vertex_offset;
+    u32 padding;
+};
+
+// Where a mesh ended up in the scene's shared index and vertex buffers
+struct vk_gpu_scene_mesh {
+    u32 first_index;
+    u32 index_count;
+    i32 vertex_offset;
+    glm::vec4 bounding_sphere;
+};
+
+// Two phase occlusion culling. The early phase draws what was visible last frame, a depth pyramid is built from that,
+// and the late phase tests everything else against it. Frustum only skips the occlusion test and draws in one phase
+enum vk_gpu_cull_phase : u32 {
+    GPU_CULL_PHASE_EARLY = 0,
+    GPU_CULL_PHASE_LATE = 1,
+    GPU_CULL_PHASE_FRUSTUM_ONLY = 2,
+};
+
+// Depth pyramid the late phase tests against
+struct vk_gpu_cull_occlusion {
+    u32 pyramid_index; // Bindless sampled image
+    u32 sampler_index;
+    VkExtent2D pyramid_extent;
+    u32 level_count;
+};
+
+// Layout matches the CullParams struct in cull.comp, written by the cpu into the frame's host visible buffer
+struct vk_gpu_cull_params {
+    glm::mat4 view_projection;
+    glm::vec4 frustum_planes[6]; // xyz points into the frustum, w is the distance
+    glm::vec2 pyramid_size;
+    u32 pyramid_index;
+    u32 sampler_index;
+    u32 pyramid_levels;
+    u32 padding[3];
+};
+
+struct vk_gpu_cull_push_constants {
+    VkDeviceAddress params;
+    VkDeviceAddress object_buffer;
+    VkDeviceAddress visibility_buffer;
+    VkDeviceAddress draw_buffer;
+    VkDeviceAddress count_buffer;
+    u32 object_count;
+    u32 phase;
+    u32 draw_capacity; // Commands per draw list, the late phase writes into the second list
+};
+
+struct vk_gpu_indirect_push_constants {
+    glm::mat4 view_projection;
+    VkDeviceAddress object_buffer;
+    VkDeviceAddress vertex_buffer;
+};
+
+// Every object of the scene lives in one storage buffer, a compute pass culls them against the frustum and writes
+// the survivors into an indirect draw buffer. All meshes share one index and one vertex buffer, so the whole scene is a single draw call
+class vk_gpu_scene {
+public:
+    void init(VkDevice device, VmaAllocator allocator, vk_uploader* uploader, u32 frame_count, u32 max_objects, u32 max_vertices, u32 max_indices);
+    void destroy();
+
+    /**
+     *  @brief Appends a mesh to the shared buffers, the copy goes through the uploader
+     */
+    vk_gpu_scene_mesh add_mesh(std::span<const u32> indices, std::span<const vk_vertex> vertices);
+
+    /**
+     *  @brief Adds an instance of a mesh, returns its object index
+     */
+    u32 add_object(const vk_gpu_scene_mesh& mesh, const glm::mat4& world_matrix);
+
+    void set_transform(u32 object, const glm::mat4& world_matrix);
+
+    /**
+     *  @brief Queues the objects that changed since the last sync on the uploader, call it before the uploader gets flushed
+     */
+    void sync();
+
+    /**
+     *  @brief Records the culling dispatch of a phase, has to be recorded outside of rendering. The early and frustum only phases
+     *  reset the frame's draw counts, so they come first. Only the late phase reads the occlusion pyramid.
+     *  The caller makes the written draw commands visible to VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT before record_draw
+     */
+    void record_cull(VkCommandBuffer cmd, u32 frame_index, vk_gpu_cull_phase phase, VkPipeline pipeline, VkPipelineLayout layout,
+                     const glm::mat4& view_projection, const vk_gpu_cull_occlusion& occlusion);
+
+    /**
+     *  @brief Draws the objects that survived record_cull of the same frame and phase
+     */
+    void record_draw(VkCommandBuffer cmd, u32 frame_index, vk_gpu_cull_phase phase, VkPipeline pipeline, VkPipelineLayout layout, const glm::mat4& view_projection);
+
+    u32 get_object_count() const { return (u32)objects.size(); }
+
+private:
+    // The culling output of a frame, the previous frame may still be drawing from its own.
+    // The draw and count buffers hold one list per phase, early and frustum only share the first
+    struct frame_buffers {
+        vk_allocated_buffer draw_buffer;
+        VkDeviceAddress draw_buffer_address;
+        vk_allocated_buffer count_buffer;
+        VkDeviceAddress count_buffer_address;
+        vk_allocated_buffer params_buffer; // Persistently mapped
+        VkDeviceAddress params_buffer_address;
+    };
+
+    vk_allocated_buffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VkDeviceAddress* address);
+
+    VkDevice device;
+    VmaAllocator allocator;
+    vk_uploader* uploader;
+
+    u32 max_objects;
+    u32 max_vertices;
+    u32 max_indices;
+
+    vk_allocated_buffer object_buffer;
+    VkDeviceAddress object_buffer_address;
+
+    // One flag per object whether it passed the last late phase, the next early phase draws those
+    vk_allocated_buffer visibility_buffer;
+    VkDeviceAddress visibility_buffer_address;
+    bool visibility_cleared = false;
+
+    vk_allocated_buffer index_buffer;
+    vk_allocated_buffer vertex_buffer;
+    VkDeviceAddress vertex_buffer_address;
+    u32 vertex_count = 0;
+    u32 index_count = 0;
+
+    std::vector<frame_buffers> frames;
+
+    std::vector<vk_gpu_object> objects; // Cpu copy, changed objects get uploaded on sync
+    u32 dirty_begin = 0;
+    u32 dirty_end = 0;
+};
+
+#endif //VK_GPU_SCENE_H
@@ -4,6 +4,8 @@
 
 #include "vk_images.h"
 
+#include <algorithm>
+
 #include "vk_initializers.h"
 
 void vkutil::transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout) {
@@ -18,7 +20,11 @@ void vkutil::transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout
     imageBarrier.oldLayout = currentLayout;
     imageBarrier.newLayout = newLayout;
 
-    VkImageAspectFlags aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    // Depth images keep going between attachment and read only layouts, either side tells us which aspect to use
+    bool is_depth = newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL || newLayout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL
+                    || currentLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL || currentLayout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+
+    VkImageAspectFlags aspectMask = is_depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
     imageBarrier.subresourceRange = vkinit::image_subresource_range(aspectMask);
     imageBarrier.image = image;
 
@@ -63,4 +69,147 @@ void vkutil::copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage de
     blitInfo.pRegions = &blitRegion;
 
     vkCmdBlitImage2(cmd, &blitInfo);
-}
\ No newline at end of file
+}
+
+void vkutil::copy_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D size) {
+    // Unlike the blit this requires both images to have the same format, but it doesn't filter
+    VkImageCopy2 copyRegion{ .sType = VK_STRUCTURE_TYPE_IMAGE_COPY_2, .pNext = nullptr };
+
+    copyRegion.extent = VkExtent3D{ size.width, size.height, 1 };
+
+    copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.srcSubresource.baseArrayLayer = 0;
+    copyRegion.srcSubresource.layerCount = 1;
+    copyRegion.srcSubresource.mipLevel = 0;
+
+    copyRegion.dstSubresource = copyRegion.srcSubresource;
+
+    VkCopyImageInfo2 copyInfo{ .sType = VK_STRUCTURE_TYPE_COPY_IMAGE_INFO_2, .pNext = nullptr };
+    copyInfo.dstImage = destination;
+    copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    copyInfo.srcImage = source;
+    copyInfo.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    copyInfo.regionCount = 1;
+    copyInfo.pRegions = &copyRegion;
+
+    vkCmdCopyImage2(cmd, &copyInfo);
+}
+
+void vkutil::generate_mipmaps(VkCommandBuffer cmd, VkImage image, VkExtent2D image_size, u32 mip_levels) {
+    for(u32 level = 0; level < mip_levels; level++) {
+        // The level is done once the copy or the previous blit wrote it, it becomes the source of the next one
+        VkImageMemoryBarrier2 imageBarrier {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+        imageBarrier.pNext = nullptr;
+
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        imageBarrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+        imageBarrier.subresourceRange.baseMipLevel = level;
+        imageBarrier.subresourceRange.levelCount = 1;
+        imageBarrier.image = image;
+
+        VkDependencyInfo depInfo {};
+        depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        depInfo.pNext = nullptr;
+
+        depInfo.imageMemoryBarrierCount = 1;
+        depInfo.pImageMemoryBarriers = &imageBarrier;
+
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+
+        if(level + 1 == mip_levels) break;
+
+        VkExtent2D half_size = { std::max(image_size.width / 2, 1u), std::max(image_size.height / 2, 1u) };
+
+        VkImageBlit2 blitRegion{ .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2, .pNext = nullptr };
+
+        blitRegion.srcOffsets[1].x = image_size.width;
+        blitRegion.srcOffsets[1].y = image_size.height;
+        blitRegion.srcOffsets[1].z = 1;
+
+        blitRegion.dstOffsets[1].x = half_size.width;
+        blitRegion.dstOffsets[1].y = half_size.height;
+        blitRegion.dstOffsets[1].z = 1;
+
+        blitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blitRegion.srcSubresource.baseArrayLayer = 0;
+        blitRegion.srcSubresource.layerCount = 1;
+        blitRegion.srcSubresource.mipLevel = level;
+
+        blitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blitRegion.dstSubresource.baseArrayLayer = 0;
+        blitRegion.dstSubresource.layerCount = 1;
+        blitRegion.dstSubresource.mipLevel = level + 1;
+
+        VkBlitImageInfo2 blitInfo{ .sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2, .pNext = nullptr };
+        blitInfo.dstImage = image;
+        blitInfo.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        blitInfo.srcImage = image;
+        blitInfo.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        blitInfo.filter = VK_FILTER_LINEAR;
+        blitInfo.regionCount = 1;
+        blitInfo.pRegions = &blitRegion;
+
+        vkCmdBlitImage2(cmd, &blitInfo);
+
+        image_size = half_size;
+    }
+}
+
+VkBufferMemoryBarrier2 vkutil::buffer_ownership_barrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, u32 src_family, u32 dst_family, bool is_release) {
+    VkBufferMemoryBarrier2 bufferBarrier {.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+    bufferBarrier.pNext = nullptr;
+
+    // The release only has to make the copy available, the acquire makes it visible to everything on the new queue
+    if(is_release) {
+        bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        bufferBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        bufferBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+    } else {
+        bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        bufferBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+
+    bufferBarrier.srcQueueFamilyIndex = src_family;
+    bufferBarrier.dstQueueFamilyIndex = dst_family;
+    bufferBarrier.buffer = buffer;
+    bufferBarrier.offset = offset;
+    bufferBarrier.size = size;
+
+    return bufferBarrier;
+}
+
+VkImageMemoryBarrier2 vkutil::image_ownership_barrier(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, u32 src_family, u32 dst_family, bool is_release) {
+    VkImageMemoryBarrier2 imageBarrier {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    imageBarrier.pNext = nullptr;
+
+    if(is_release) {
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+    } else {
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+
+    imageBarrier.oldLayout = old_layout;
+    imageBarrier.newLayout = new_layout;
+    imageBarrier.srcQueueFamilyIndex = src_family;
+    imageBarrier.dstQueueFamilyIndex = dst_family;
+    imageBarrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    imageBarrier.image = image;
+
+    return imageBarrier;
+}
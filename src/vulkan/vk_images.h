@@ -10,6 +10,15 @@
 namespace vkutil {
     void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout);
     void copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize);
+    void copy_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D size);
+
+    // Fills every level below mip 0 with a chain of linear blits. All levels start in TRANSFER_DST_OPTIMAL and end up in TRANSFER_SRC_OPTIMAL
+    void generate_mipmaps(VkCommandBuffer cmd, VkImage image, VkExtent2D image_size, u32 mip_levels);
+
+    // Queue family ownership transfers of resources written by transfer commands. The release is recorded on the src family's queue,
+    // the acquire with the same arguments on the dst family's queue, after waiting for the release's submission
+    VkBufferMemoryBarrier2 buffer_ownership_barrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, u32 src_family, u32 dst_family, bool is_release);
+    VkImageMemoryBarrier2 image_ownership_barrier(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, u32 src_family, u32 dst_family, bool is_release);
 }
 
 #endif //VK_IMAGES_H
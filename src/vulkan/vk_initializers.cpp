@@ -161,6 +161,22 @@ VkRenderingAttachmentInfo vkinit::attachment_info(VkImageView view, VkClearValue
     return color_attachment;
 }
 
+VkRenderingAttachmentInfo vkinit::depth_attachment_info(VkImageView view, bool clear, VkImageLayout layout) {
+    VkRenderingAttachmentInfo depth_attachment {};
+    depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depth_attachment.pNext = nullptr;
+
+    depth_attachment.imageView = view;
+    depth_attachment.imageLayout = layout;
+    depth_attachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    // Reversed depth, 0 is the far plane
+    depth_attachment.clearValue.depthStencil.depth = 0.f;
+
+    return depth_attachment;
+}
+
 VkRenderingInfo vkinit::rendering_info(VkExtent2D renderExtent, VkRenderingAttachmentInfo* colorAttachment, VkRenderingAttachmentInfo* depthAttachment) {
     VkRenderingInfo render_info {};
     render_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
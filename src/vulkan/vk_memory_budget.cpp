@@ -0,0 +1,54 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_memory_budget.h"
+
+#include <algorithm>
+
+void vk_memory_budget::init(VmaAllocator allocator, bool has_budget_extension) {
+    this->allocator = allocator;
+    this->budget_extension = has_budget_extension;
+
+    const VkPhysicalDeviceMemoryProperties* memory_properties;
+    vmaGetMemoryProperties(allocator, &memory_properties);
+
+    budgets.resize(memory_properties->memoryHeapCount);
+    heaps.resize(memory_properties->memoryHeapCount);
+    over_budget.assign(memory_properties->memoryHeapCount, false);
+
+    for(u32 i = 0; i < heaps.size(); i++) {
+        heaps[i] = { 0, memory_properties->memoryHeaps[i].size, 0, (memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 };
+    }
+}
+
+void vk_memory_budget::update(u32 frame_number) {
+    // VMA only queries the driver's budget again every few allocations or when the frame index changes
+    vmaSetCurrentFrameIndex(allocator, frame_number);
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    for(u32 i = 0; i < heaps.size(); i++) {
+        heaps[i].usage = budgets[i].usage;
+        heaps[i].budget = budgets[i].budget;
+        heaps[i].allocated = budgets[i].statistics.blockBytes;
+
+        bool over = budgets[i].usage > budgets[i].budget;
+        if(over && !over_budget[i]) {
+            LOG_INFO("Memory heap " << i << " is over budget: " << (budgets[i].usage >> 20) << " MiB used of " << (budgets[i].budget >> 20) << " MiB");
+        }
+
+        over_budget[i] = over;
+    }
+}
+
+f32 vk_memory_budget::get_device_local_pressure() const {
+    f32 pressure = 0.f;
+
+    for(const vk_heap_budget& heap : heaps) {
+        if(!heap.device_local || heap.budget == 0) continue;
+
+        pressure = std::max(pressure, (f32)((f64)heap.usage / (f64)heap.budget));
+    }
+
+    return pressure;
+}
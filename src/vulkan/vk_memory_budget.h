@@ -0,0 +1,46 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_MEMORY_BUDGET_H
+#define VK_MEMORY_BUDGET_H
+
+#include "vk_types.h"
+
+struct vk_heap_budget {
+    VkDeviceSize usage; // What the process uses in the heap, including memory not allocated through VMA
+    VkDeviceSize budget; // How much it can use before allocations start failing or getting evicted
+    VkDeviceSize allocated; // Bytes of VMA's memory blocks in the heap
+    bool device_local;
+};
+
+// Tracks the usage and budget of every memory heap, refreshed once per frame. With VK_EXT_memory_budget the numbers come
+// from the driver and account for other processes, without it VMA estimates the budget as 80% of the heap size
+class vk_memory_budget {
+public:
+    void init(VmaAllocator allocator, bool has_budget_extension);
+
+    /**
+     *  @brief Reads the budgets of the frame that is starting, logs heaps that went over budget since the last update
+     */
+    void update(u32 frame_number);
+
+    std::span<const vk_heap_budget> get_heaps() const { return heaps; }
+
+    /**
+     *  @brief Highest usage to budget ratio of the device local heaps, above 1 the driver starts paging memory out
+     */
+    f32 get_device_local_pressure() const;
+
+    bool has_budget_extension() const { return budget_extension; }
+
+private:
+    VmaAllocator allocator;
+    bool budget_extension;
+
+    std::vector<VmaBudget> budgets; // Scratch for vmaGetHeapBudgets
+    std::vector<vk_heap_budget> heaps;
+    std::vector<bool> over_budget; // Heaps that were over budget at the last update, so crossing it only logs once
+};
+
+#endif //VK_MEMORY_BUDGET_H
@@ -0,0 +1,174 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_parallel_recorder.h"
+
+#include <algorithm>
+
+#include "vk_initializers.h"
+
+void vk_parallel_recorder::init(VkDevice device, u32 queue_family, u32 frame_count, u32 worker_count) {
+    this->device = device;
+    thread_count = worker_count + 1;
+
+    stopping = false;
+
+    // Transient, the pools are reset as a whole once their frame slot is idle
+    VkCommandPoolCreateInfo pool_info = vkinit::command_pool_create_info(queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+    pools.resize(frame_count * thread_count);
+    for(auto& pool : pools) {
+        VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &pool.pool));
+        pool.used = 0;
+    }
+
+    for(u32 i = 0; i < worker_count; i++) {
+        workers.emplace_back(&vk_parallel_recorder::worker_loop, this, i);
+    }
+}
+
+void vk_parallel_recorder::destroy() {
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        stopping = true;
+    }
+
+    job_cv.notify_all();
+
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    workers.clear();
+
+    // Destroying a pool frees its command buffers
+    for(auto& pool : pools) {
+        vkDestroyCommandPool(device, pool.pool, nullptr);
+    }
+
+    pools.clear();
+}
+
+void vk_parallel_recorder::reset_frame(u32 frame_index) {
+    for(u32 i = 0; i < thread_count; i++) {
+        thread_pool& pool = pools[frame_index * thread_count + i];
+        if(pool.used == 0) continue;
+
+        VK_CHECK(vkResetCommandPool(device, pool.pool, 0));
+        pool.used = 0;
+    }
+}
+
+std::span<const VkCommandBuffer> vk_parallel_recorder::record(u32 frame_index, const VkCommandBufferInheritanceRenderingInfo& rendering_info, u32 chunk_count,
+                                                              const std::function<void(VkCommandBuffer cmd, u32 chunk)>& record) {
+    u64 job;
+
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+
+        job = ++job_id;
+        job_frame = frame_index;
+        job_chunk_count = chunk_count;
+        next_chunk = 0;
+        chunks_done = 0;
+        job_record = &record;
+        job_error = nullptr;
+
+        // Secondaries inherit the rendering pass through the pNext chain
+        job_inheritance = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+        job_inheritance.pNext = &rendering_info;
+
+        recorded.assign(chunk_count, VK_NULL_HANDLE);
+    }
+
+    job_cv.notify_all();
+
+    // The calling thread takes chunks as well instead of idling until the workers are done
+    record_chunks(thread_count - 1, job);
+
+    std::unique_lock<std::mutex> lock(job_mutex);
+    done_cv.wait(lock, [this]() { return chunks_done == job_chunk_count; });
+
+    job_record = nullptr;
+
+    if(job_error) {
+        std::rethrow_exception(job_error);
+    }
+
+    return recorded;
+}
+
+void vk_parallel_recorder::worker_loop(u32 thread_index) {
+    u64 seen_job = 0;
+
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job_cv.wait(lock, [&]() { return stopping || job_id != seen_job; });
+
+            if(stopping) return;
+
+            seen_job = job_id;
+        }
+
+        record_chunks(thread_index, seen_job);
+    }
+}
+
+void vk_parallel_recorder::record_chunks(u32 thread_index, u64 job) {
+    while(true) {
+        u32 chunk;
+        thread_pool* pool;
+        const VkCommandBufferInheritanceInfo* inheritance;
+        const std::function<void(VkCommandBuffer, u32)>* record;
+
+        {
+            // A worker that woke up late may find the next job already posted, that one gets picked up from worker_loop
+            std::lock_guard<std::mutex> lock(job_mutex);
+            if(job_id != job || next_chunk >= job_chunk_count) return;
+
+            chunk = next_chunk++;
+            pool = &pools[job_frame * thread_count + thread_index];
+            inheritance = &job_inheritance;
+            record = job_record;
+        }
+
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+
+        try {
+            cmd = acquire_buffer(*pool);
+
+            VkCommandBufferBeginInfo begin_info = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+            begin_info.pInheritanceInfo = inheritance;
+
+            VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+            (*record)(cmd, chunk);
+            VK_CHECK(vkEndCommandBuffer(cmd));
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            if(!job_error) job_error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(job_mutex);
+        recorded[chunk] = cmd;
+
+        if(++chunks_done == job_chunk_count) {
+            done_cv.notify_one();
+        }
+    }
+}
+
+VkCommandBuffer vk_parallel_recorder::acquire_buffer(thread_pool& pool) {
+    if(pool.used == pool.buffers.size()) {
+        VkCommandBufferAllocateInfo cmd_info = vkinit::command_buffer_allocate_info(pool.pool, 1);
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+        VkCommandBuffer cmd;
+        VK_CHECK(vkAllocateCommandBuffers(device, &cmd_info, &cmd));
+
+        pool.buffers.push_back(cmd);
+    }
+
+    return pool.buffers[pool.used++];
+}
@@ -0,0 +1,79 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_PARALLEL_RECORDER_H
+#define VK_PARALLEL_RECORDER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "vk_types.h"
+
+// Records the chunks of a pass into secondary command buffers on a pool of worker threads, the calling thread records chunks too.
+// Every thread has its own command pool per frame in flight, so recording never takes a lock on a pool
+class vk_parallel_recorder {
+public:
+    void init(VkDevice device, u32 queue_family, u32 frame_count, u32 worker_count);
+
+    /**
+     *  @brief Joins the workers and destroys the pools, nothing may be recording
+     */
+    void destroy();
+
+    /**
+     *  @brief Resets the pools of a frame slot, call it once the gpu is done with the slot
+     */
+    void reset_frame(u32 frame_index);
+
+    /**
+     *  @brief Records chunk_count secondary command buffers inside the dynamic rendering pass described by rendering_info,
+     *  calling record once per chunk. Blocks until every chunk is recorded and returns them in chunk order, ready for vkCmdExecuteCommands.
+     *  An exception thrown by record is rethrown here
+     */
+    std::span<const VkCommandBuffer> record(u32 frame_index, const VkCommandBufferInheritanceRenderingInfo& rendering_info, u32 chunk_count,
+                                            const std::function<void(VkCommandBuffer cmd, u32 chunk)>& record);
+
+    /**
+     *  @brief Threads recording in parallel, the workers and the calling thread
+     */
+    u32 get_thread_count() const { return thread_count; }
+private:
+    struct thread_pool {
+        VkCommandPool pool;
+        std::vector<VkCommandBuffer> buffers; // Secondaries allocated so far, reused after every reset
+        u32 used;
+    };
+
+    void worker_loop(u32 thread_index);
+
+    // Records chunks of job until none are left or a newer job replaced it
+    void record_chunks(u32 thread_index, u64 job);
+
+    VkCommandBuffer acquire_buffer(thread_pool& pool);
+
+    VkDevice device;
+    u32 thread_count;
+
+    std::vector<thread_pool> pools; // thread_count pools per frame slot, the calling thread uses the last one
+    std::vector<std::thread> workers;
+
+    // The job being recorded, guarded by job_mutex. Workers pick chunks until all are taken
+    std::mutex job_mutex;
+    std::condition_variable job_cv;
+    std::condition_variable done_cv;
+    u64 job_id = 0;
+    u32 job_frame = 0;
+    u32 job_chunk_count = 0;
+    u32 next_chunk = 0;
+    u32 chunks_done = 0;
+    VkCommandBufferInheritanceInfo job_inheritance{};
+    const std::function<void(VkCommandBuffer, u32)>* job_record = nullptr;
+    std::exception_ptr job_error;
+    bool stopping = false;
+
+    std::vector<VkCommandBuffer> recorded; // Indexed by chunk
+};
+
+#endif //VK_PARALLEL_RECORDER_H
@@ -0,0 +1,177 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_pipeline_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+void vk_pipeline_cache::init(VkDevice device, VkPhysicalDevice gpu, const std::string& file_path) {
+    this->file_path = file_path;
+
+    VkPhysicalDeviceProperties gpu_properties;
+    vkGetPhysicalDeviceProperties(gpu, &gpu_properties);
+
+    // Read the whole file, a missing file just means a cold start
+    std::vector<u8> data;
+    std::ifstream file(file_path, std::ios::ate | std::ios::binary);
+    if(file.is_open()) {
+        data.resize((u64)file.tellg());
+
+        file.seekg(0);
+        file.read((char*)data.data(), (std::streamsize)data.size());
+        file.close();
+    }
+
+    loaded_from_disk = !data.empty() && validate_header(data, gpu_properties);
+
+    VkPipelineCacheCreateInfo cache_info = {.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    cache_info.pNext = nullptr;
+    cache_info.flags = 0;
+    cache_info.initialDataSize = loaded_from_disk ? data.size() : 0;
+    cache_info.pInitialData = loaded_from_disk ? data.data() : nullptr;
+
+    VK_CHECK(vkCreatePipelineCache(device, &cache_info, nullptr, &cache));
+
+    if(loaded_from_disk) {
+        LOG_INFO("Pipeline cache: loaded " << data.size() << " bytes from " << file_path);
+    } else {
+        LOG_INFO("Pipeline cache: starting cold");
+    }
+}
+
+bool vk_pipeline_cache::validate_header(const std::vector<u8>& data, const VkPhysicalDeviceProperties& gpu_properties) {
+    // Drivers are supposed to reject foreign caches themselves, but not all of them do it gracefully
+    if(data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        LOG_INFO("Pipeline cache: file is too small, ignoring it");
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    if(header.headerSize < sizeof(header) || header.headerSize > data.size() || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        LOG_INFO("Pipeline cache: unknown header, ignoring it");
+        return false;
+    }
+
+    if(header.vendorID != gpu_properties.vendorID || header.deviceID != gpu_properties.deviceID) {
+        LOG_INFO("Pipeline cache: written by a different gpu, ignoring it");
+        return false;
+    }
+
+    if(memcmp(header.pipelineCacheUUID, gpu_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        LOG_INFO("Pipeline cache: written by a different driver version, ignoring it");
+        return false;
+    }
+
+    return true;
+}
+
+bool vk_pipeline_cache::save(VkDevice device) {
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr));
+
+    std::vector<u8> data(size);
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, data.data()));
+
+    std::string tmp_path = file_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if(!file.is_open()) {
+            LOG_INFO("Pipeline cache: failed to open " << tmp_path << " for writing");
+            return false;
+        }
+
+        file.write((const char*)data.data(), (std::streamsize)size);
+        if(!file.good()) {
+            LOG_INFO("Pipeline cache: failed to write " << tmp_path);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, file_path, ec);
+    if(ec) {
+        LOG_INFO("Pipeline cache: failed to replace " << file_path << ": " << ec.message());
+        return false;
+    }
+
+    LOG_INFO("Pipeline cache: saved " << size << " bytes to " << file_path);
+    return true;
+}
+
+void vk_pipeline_cache::destroy(VkDevice device) {
+    vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+VkResult vk_pipeline_cache::create_graphics_pipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& create_info, VkPipeline* out_pipeline) {
+    // Chain the creation feedback in front of whatever the caller already chained
+    VkPipelineCreationFeedback feedback{};
+    VkPipelineCreationFeedbackCreateInfo feedback_info = {.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO};
+    feedback_info.pNext = create_info.pNext;
+    feedback_info.pPipelineCreationFeedback = &feedback;
+
+    VkGraphicsPipelineCreateInfo info = create_info;
+    info.pNext = &feedback_info;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkResult res = vkCreateGraphicsPipelines(device, cache, 1, &info, nullptr, out_pipeline);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if(res == VK_SUCCESS) {
+        record(feedback, std::chrono::duration<f64, std::milli>(end - start).count());
+    }
+
+    return res;
+}
+
+VkResult vk_pipeline_cache::create_compute_pipeline(VkDevice device, const VkComputePipelineCreateInfo& create_info, VkPipeline* out_pipeline) {
+    VkPipelineCreationFeedback feedback{};
+    VkPipelineCreationFeedbackCreateInfo feedback_info = {.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO};
+    feedback_info.pNext = create_info.pNext;
+    feedback_info.pPipelineCreationFeedback = &feedback;
+
+    VkComputePipelineCreateInfo info = create_info;
+    info.pNext = &feedback_info;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkResult res = vkCreateComputePipelines(device, cache, 1, &info, nullptr, out_pipeline);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if(res == VK_SUCCESS) {
+        record(feedback, std::chrono::duration<f64, std::milli>(end - start).count());
+    }
+
+    return res;
+}
+
+void vk_pipeline_cache::record(const VkPipelineCreationFeedback& feedback, f64 ms) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+
+    stats.pipelines_created++;
+    stats.creation_ms += ms;
+
+    // Without valid feedback we can't tell, count it as a miss
+    bool valid = feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+    if(valid && (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT)) {
+        stats.cache_hits++;
+    } else {
+        stats.cache_misses++;
+    }
+}
+
+vk_pipeline_cache_stats vk_pipeline_cache::get_stats() {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    return stats;
+}
+
+void vk_pipeline_cache::log_stats() {
+    vk_pipeline_cache_stats current = get_stats();
+
+    LOG_INFO("Pipeline cache: " << current.pipelines_created << " pipelines created in " << current.creation_ms << "ms ("
+             << current.cache_hits << " hits, " << current.cache_misses << " misses, " << (is_warm() ? "warm" : "cold") << " start)");
+}
@@ -0,0 +1,53 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_PIPELINE_CACHE_H
+#define VK_PIPELINE_CACHE_H
+
+#include <mutex>
+
+#include "vk_types.h"
+
+struct vk_pipeline_cache_stats {
+    u32 pipelines_created;
+    u32 cache_hits; // Pipelines the driver could build without compiling anything
+    u32 cache_misses;
+    f64 creation_ms; // Time spent inside vkCreate*Pipelines
+};
+
+// VkPipelineCache that is loaded from and saved to disk
+class vk_pipeline_cache {
+public:
+    /**
+     *  @brief Creates the cache, seeded with the file contents if it was written by the same driver and device
+     */
+    void init(VkDevice device, VkPhysicalDevice gpu, const std::string& file_path);
+
+    /**
+     *  @brief Writes the cache to disk through a temporary file, so a crash never leaves a truncated cache behind
+     */
+    bool save(VkDevice device);
+    void destroy(VkDevice device);
+
+    VkResult create_graphics_pipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& create_info, VkPipeline* out_pipeline);
+    VkResult create_compute_pipeline(VkDevice device, const VkComputePipelineCreateInfo& create_info, VkPipeline* out_pipeline);
+
+    vk_pipeline_cache_stats get_stats();
+    void log_stats();
+
+    VkPipelineCache get() const { return cache; }
+    bool is_warm() const { return loaded_from_disk; }
+private:
+    bool validate_header(const std::vector<u8>& data, const VkPhysicalDeviceProperties& gpu_properties);
+    void record(const VkPipelineCreationFeedback& feedback, f64 ms);
+
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    std::string file_path;
+    bool loaded_from_disk = false;
+
+    std::mutex stats_mutex;
+    vk_pipeline_cache_stats stats{};
+};
+
+#endif //VK_PIPELINE_CACHE_H
@@ -0,0 +1,128 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_pipeline_compiler.h"
+
+#include <algorithm>
+
+#include "vk_initializers.h"
+
+void vk_pipeline_compiler::init(VkDevice device, vk_shader_registry* shaders, vk_pipeline_cache* cache, u32 worker_count) {
+    this->device = device;
+    this->shaders = shaders;
+    this->cache = cache;
+
+    stopping = false;
+
+    for(u32 i = 0; i < std::max(worker_count, 1u); i++) {
+        workers.emplace_back(&vk_pipeline_compiler::worker_loop, this);
+    }
+}
+
+void vk_pipeline_compiler::destroy() {
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+
+    jobs_cv.notify_all();
+
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    workers.clear();
+}
+
+std::future<VkPipeline> vk_pipeline_compiler::compile(vk_compute_pipeline_desc desc) {
+    return enqueue([this, desc = std::move(desc)]() {
+        return build_compute(desc);
+    });
+}
+
+std::future<VkPipeline> vk_pipeline_compiler::compile(vk_graphics_pipeline_desc desc) {
+    return enqueue([this, desc = std::move(desc)]() mutable {
+        return build_graphics(desc);
+    });
+}
+
+std::future<VkPipeline> vk_pipeline_compiler::enqueue(std::function<VkPipeline()>&& job) {
+    std::packaged_task<VkPipeline()> task(std::move(job));
+    std::future<VkPipeline> future = task.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.push_back(std::move(task));
+    }
+
+    jobs_cv.notify_one();
+
+    return future;
+}
+
+void vk_pipeline_compiler::worker_loop() {
+    while(true) {
+        std::packaged_task<VkPipeline()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+            // Drain the queue before stopping so no future is left without a value
+            if(jobs.empty()) return;
+
+            task = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        // Exceptions end up in the future
+        task();
+    }
+}
+
+VkPipeline vk_pipeline_compiler::build_compute(const vk_compute_pipeline_desc& desc) {
+    // Modules stay in the registry, other pipelines may use them too
+    VkShaderModule shader = shaders->get(shaders->load(desc.shader_path));
+
+    VkComputePipelineCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    create_info.pNext = nullptr;
+    create_info.layout = desc.layout;
+    create_info.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, shader);
+
+    std::vector<VkSpecializationMapEntry> map_entries(desc.specialization.size());
+    for(u32 i = 0; i < map_entries.size(); i++) {
+        map_entries[i] = { .constantID = i, .offset = i * (u32)sizeof(u32), .size = sizeof(u32) };
+    }
+
+    VkSpecializationInfo specialization_info{};
+    specialization_info.mapEntryCount = (u32)map_entries.size();
+    specialization_info.pMapEntries = map_entries.data();
+    specialization_info.dataSize = desc.specialization.size() * sizeof(u32);
+    specialization_info.pData = desc.specialization.data();
+
+    if(!desc.specialization.empty()) {
+        create_info.stage.pSpecializationInfo = &specialization_info;
+    }
+
+    VkPipeline pipeline;
+    VK_CHECK(cache ? cache->create_compute_pipeline(device, create_info, &pipeline)
+                   : vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+
+    return pipeline;
+}
+
+VkPipeline vk_pipeline_compiler::build_graphics(vk_graphics_pipeline_desc& desc) {
+    VkShaderModule vert_shader = shaders->get(shaders->load(desc.vert_shader_path));
+    VkShaderModule frag_shader = shaders->get(shaders->load(desc.frag_shader_path));
+
+    desc.builder.set_shaders(vert_shader, frag_shader);
+    VkPipeline pipeline = desc.builder.build_pipeline(device, cache);
+
+    if(pipeline == VK_NULL_HANDLE) {
+        LOG_THROW("Failed to build graphics pipeline from " + desc.vert_shader_path + " and " + desc.frag_shader_path);
+    }
+
+    return pipeline;
+}
@@ -0,0 +1,67 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_PIPELINE_COMPILER_H
+#define VK_PIPELINE_COMPILER_H
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "vk_pipelines.h"
+#include "vk_shader_registry.h"
+
+struct vk_compute_pipeline_desc {
+    std::string shader_path;
+    VkPipelineLayout layout;
+
+    // Values of the shader's specialization constants, the first one goes to constant_id 0 and so on
+    std::vector<u32> specialization;
+};
+
+struct vk_graphics_pipeline_desc {
+    std::string vert_shader_path;
+    std::string frag_shader_path;
+
+    // Fully configured builder, the compiler only fills in the shaders
+    vk_pipeline_builder builder;
+};
+
+// Loads shaders and creates pipelines on a pool of worker threads
+class vk_pipeline_compiler {
+public:
+    void init(VkDevice device, vk_shader_registry* shaders, vk_pipeline_cache* cache, u32 worker_count);
+
+    /**
+     *  @brief Finishes every queued job and joins the workers
+     */
+    void destroy();
+
+    /**
+     *  @brief Queues a pipeline build, the future throws if a shader failed to load or the pipeline failed to build
+     */
+    std::future<VkPipeline> compile(vk_compute_pipeline_desc desc);
+    std::future<VkPipeline> compile(vk_graphics_pipeline_desc desc);
+
+    u32 get_worker_count() const { return (u32)workers.size(); }
+private:
+    std::future<VkPipeline> enqueue(std::function<VkPipeline()>&& job);
+    void worker_loop();
+
+    VkPipeline build_compute(const vk_compute_pipeline_desc& desc);
+    VkPipeline build_graphics(vk_graphics_pipeline_desc& desc);
+
+    VkDevice device;
+    vk_shader_registry* shaders;
+    vk_pipeline_cache* cache;
+
+    std::vector<std::thread> workers;
+    std::deque<std::packaged_task<VkPipeline()>> jobs;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    bool stopping = false;
+};
+
+#endif //VK_PIPELINE_COMPILER_H
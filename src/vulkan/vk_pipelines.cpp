@@ -4,46 +4,8 @@
 
 #include "vk_pipelines.h"
 
-#include <fstream>
-
-
 #include "vk_initializers.h"
 
-bool vkutil::load_shader_module(const char *file_path, VkDevice device, VkShaderModule *out_shader_module) {
-    // open the file, with cursor at the end
-    std::ifstream file(file_path, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-        return false;
-    }
-
-    u64 file_size = (u64) file.tellg();
-
-    // spirv expects the buffer to be on u32 so make sure to reserve enough space
-    std::vector<u32> buffer(file_size / sizeof(u32));
-
-    file.seekg(0);
-    file.read((char *) buffer.data(), file_size);
-    file.close();
-
-    // Create the shader module
-    VkShaderModuleCreateInfo create_info = {};
-    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    create_info.codeSize = buffer.size() * sizeof(u32);
-    create_info.pCode = buffer.data();
-
-    create_info.pNext = nullptr;
-
-    // check if the creation was successful
-    VkShaderModule shader_module;
-    if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS) {
-        return false;
-    }
-
-    *out_shader_module = shader_module;
-    return true;
-}
-
 void vk_pipeline_builder::set_shaders(VkShaderModule vert_shader, VkShaderModule frag_shader) {
     shader_stages.clear();
 
@@ -112,6 +74,18 @@ void vk_pipeline_builder::disable_depthtest() {
     depth_stencil.maxDepthBounds = 1.f;
 }
 
+void vk_pipeline_builder::enable_depthtest(bool depth_write_enable, VkCompareOp op) {
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = depth_write_enable;
+    depth_stencil.depthCompareOp = op;
+    depth_stencil.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil.stencilTestEnable = VK_FALSE;
+    depth_stencil.front = {};
+    depth_stencil.back = {};
+    depth_stencil.minDepthBounds = 0.f;
+    depth_stencil.maxDepthBounds = 1.f;
+}
+
 void vk_pipeline_builder::clear() {
     // Clear all the structures
     input_assembly = { .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
@@ -125,7 +99,7 @@ void vk_pipeline_builder::clear() {
     shader_stages.clear();
 }
 
-VkPipeline vk_pipeline_builder::build_pipeline(VkDevice device) {
+VkPipeline vk_pipeline_builder::build_pipeline(VkDevice device, vk_pipeline_cache* cache) {
     // Make viewport state from our stored viewport and scissor.
     // At the moment we won't support multiple viewports or scissors
     VkPipelineViewportStateCreateInfo viewport_state = {};
@@ -153,7 +127,8 @@ VkPipeline vk_pipeline_builder::build_pipeline(VkDevice device) {
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
     // Connect the render_info with the pipeline
-    render_info.pNext = &render_info;
+    render_info.pColorAttachmentFormats = &color_attachment_format;
+    pipeline_info.pNext = &render_info;
 
     pipeline_info.stageCount = shader_stages.size();
     pipeline_info.pStages = shader_stages.data();
@@ -176,7 +151,9 @@ VkPipeline vk_pipeline_builder::build_pipeline(VkDevice device) {
 
     // It's easy to error out on create graphics pipeline, so we handle it a bit better than the common VK_CHECK
     VkPipeline new_pipeline;
-    if(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &new_pipeline) != VK_SUCCESS) {
+    VkResult res = cache ? cache->create_graphics_pipeline(device, pipeline_info, &new_pipeline)
+                         : vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &new_pipeline);
+    if(res != VK_SUCCESS) {
         LOG_FATAL("Failed to create graphics pipeline!");
         return VK_NULL_HANDLE;
     }
@@ -5,6 +5,7 @@
 #ifndef VK_PIPELINES_H
 #define VK_PIPELINES_H
 
+#include "vk_pipeline_cache.h"
 #include "vk_types.h"
 
 class vk_pipeline_builder {
@@ -31,14 +32,11 @@ public:
     void set_color_attachment_format(VkFormat format);
     void set_depth_format(VkFormat format);
     void disable_depthtest();
+    void enable_depthtest(bool depth_write_enable, VkCompareOp op);
 
     void clear();
 
-    VkPipeline build_pipeline(VkDevice device);
+    VkPipeline build_pipeline(VkDevice device, vk_pipeline_cache* cache = nullptr);
 };
 
-namespace vkutil {
-    bool load_shader_module(const char* file_path, VkDevice device, VkShaderModule* out_shader_module);
-}
-
 #endif //VK_PIPELINES_H
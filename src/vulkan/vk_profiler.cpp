@@ -0,0 +1,184 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+void vk_profiler::init(VkPhysicalDevice gpu, u32 queue_family) {
+    VkPhysicalDeviceProperties gpu_properties;
+    vkGetPhysicalDeviceProperties(gpu, &gpu_properties);
+
+    u32 family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &family_count, nullptr);
+
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &family_count, families.data());
+
+    // Queues with 0 valid bits can't write timestamps at all, only cpu scopes will be recorded then
+    u32 valid_bits = families[queue_family].timestampValidBits;
+    gpu_supported = valid_bits != 0 && gpu_properties.limits.timestampPeriod > 0.f;
+    if(!gpu_supported) {
+        LOG_INFO("Profiler: the graphics queue doesn't support timestamps, gpu scopes are disabled");
+    }
+
+    timestamp_period = gpu_properties.limits.timestampPeriod;
+    timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+}
+
+void vk_profiler::init_frame(VkDevice device, vk_frame_queries& frame) {
+    frame.pending = false;
+    frame.query_pool = VK_NULL_HANDLE;
+
+    if(!gpu_supported) return;
+
+    VkQueryPoolCreateInfo pool_info = {.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    pool_info.pNext = nullptr;
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = PROFILER_MAX_GPU_SCOPES * 2;
+
+    VK_CHECK(vkCreateQueryPool(device, &pool_info, nullptr, &frame.query_pool));
+}
+
+void vk_profiler::destroy_frame(VkDevice device, vk_frame_queries& frame) {
+    if(frame.query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, frame.query_pool, nullptr);
+    }
+}
+
+bool vk_profiler::collect(VkDevice device, vk_frame_queries& frame) {
+    if(!frame.pending || frame.scope_names.empty()) return false;
+
+    frame.pending = false;
+
+    std::array<u64, PROFILER_MAX_GPU_SCOPES * 2> timestamps{};
+    u32 query_count = (u32)frame.scope_names.size() * 2;
+
+    // The frame has already finished on the gpu so we don't ask vulkan to wait
+    VkResult res = vkGetQueryPoolResults(device, frame.query_pool, 0, query_count, sizeof(timestamps), timestamps.data(),
+                                         sizeof(u64), VK_QUERY_RESULT_64_BIT);
+    if(res == VK_NOT_READY) return false;
+    VK_CHECK(res);
+
+    for(u32 i = 0; i < frame.scope_names.size(); i++) {
+        u64 ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestamp_mask;
+        add_sample(frame.scope_names[i], (f64)ticks * timestamp_period / 1000000.0, true);
+    }
+
+    return true;
+}
+
+void vk_profiler::begin_frame(VkCommandBuffer cmd, vk_frame_queries& frame) {
+    frame.scope_names.clear();
+    frame.open_scopes.clear();
+    frame.pending = false;
+
+    if(!gpu_supported) return;
+
+    vkCmdResetQueryPool(cmd, frame.query_pool, 0, PROFILER_MAX_GPU_SCOPES * 2);
+}
+
+void vk_profiler::begin_gpu_scope(VkCommandBuffer cmd, vk_frame_queries& frame, const char* name) {
+    if(!gpu_supported) return;
+
+    if(frame.scope_names.size() >= PROFILER_MAX_GPU_SCOPES) {
+        LOG_THROW("Profiler: too many gpu scopes in a single frame");
+    }
+
+    u32 scope = (u32)frame.scope_names.size();
+    frame.scope_names.push_back(name);
+    frame.open_scopes.push_back(scope);
+
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.query_pool, scope * 2);
+}
+
+void vk_profiler::end_gpu_scope(VkCommandBuffer cmd, vk_frame_queries& frame) {
+    if(!gpu_supported) return;
+
+    u32 scope = frame.open_scopes.back();
+    frame.open_scopes.pop_back();
+
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.query_pool, scope * 2 + 1);
+
+    // Only read the results back once every scope of the frame was closed
+    frame.pending = frame.open_scopes.empty();
+}
+
+void vk_profiler::add_cpu_sample(const char* name, f64 ms) {
+    add_sample(name, ms, false);
+}
+
+void vk_profiler::add_sample(const char* name, f64 ms, bool is_gpu) {
+    scope_history& scope = history[name];
+    scope.is_gpu = is_gpu;
+
+    scope.samples[scope.head] = ms;
+    scope.head = (scope.head + 1) % PROFILER_HISTORY_SIZE;
+    scope.count = std::min(scope.count + 1, PROFILER_HISTORY_SIZE);
+}
+
+vk_profiler_stats vk_profiler::get_stats(const std::string& name) const {
+    vk_profiler_stats stats{};
+
+    auto it = history.find(name);
+    if(it == history.end() || it->second.count == 0) return stats;
+
+    const scope_history& scope = it->second;
+
+    std::vector<f64> samples(scope.samples.begin(), scope.samples.begin() + scope.count);
+
+    stats.sample_count = scope.count;
+    stats.last = scope.samples[(scope.head + PROFILER_HISTORY_SIZE - 1) % PROFILER_HISTORY_SIZE];
+    stats.min = *std::min_element(samples.begin(), samples.end());
+
+    f64 sum = 0;
+    for(f64 sample : samples) sum += sample;
+    stats.avg = sum / scope.count;
+
+    // Nearest-rank 99th percentile
+    u32 rank = (u32)std::ceil(0.99 * scope.count) - 1;
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    stats.p99 = samples[rank];
+
+    return stats;
+}
+
+std::vector<std::string> vk_profiler::get_scope_names() const {
+    std::vector<std::string> names;
+    for(auto& [name, scope] : history) {
+        names.push_back(name);
+    }
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+f64 vk_profiler::get_last_sample(const std::string& name) const {
+    auto it = history.find(name);
+    if(it == history.end() || it->second.count == 0) return -1.0;
+
+    const scope_history& scope = it->second;
+    return scope.samples[(scope.head + PROFILER_HISTORY_SIZE - 1) % PROFILER_HISTORY_SIZE];
+}
+
+bool vk_profiler::dump_csv(const char* file_path) const {
+    std::ofstream file(file_path);
+    if(!file.is_open()) {
+        return false;
+    }
+
+    file << "scope,type,last_ms,min_ms,avg_ms,p99_ms,samples\n";
+
+    for(const std::string& name : get_scope_names()) {
+        vk_profiler_stats stats = get_stats(name);
+
+        file << name << "," << (history.at(name).is_gpu ? "gpu" : "cpu") << ","
+             << stats.last << "," << stats.min << "," << stats.avg << "," << stats.p99 << ","
+             << stats.sample_count << "\n";
+    }
+
+    return true;
+}
@@ -0,0 +1,103 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_PROFILER_H
+#define VK_PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+#include "vk_types.h"
+
+constexpr u32 PROFILER_MAX_GPU_SCOPES = 32; // Scopes that can be recorded into a single frame
+constexpr u32 PROFILER_HISTORY_SIZE = 240; // Frames of samples kept per scope
+
+// Timestamp queries recorded into one frame's command buffer. Scope i writes queries 2i and 2i + 1
+struct vk_frame_queries {
+    VkQueryPool query_pool;
+
+    std::vector<const char*> scope_names;
+    std::vector<u32> open_scopes;
+    bool pending;
+};
+
+struct vk_profiler_stats {
+    f64 last;
+    f64 min;
+    f64 avg;
+    f64 p99;
+    u32 sample_count;
+};
+
+class vk_profiler {
+public:
+    void init(VkPhysicalDevice gpu, u32 queue_family);
+    void init_frame(VkDevice device, vk_frame_queries& frame);
+    void destroy_frame(VkDevice device, vk_frame_queries& frame);
+
+    /**
+     *  @brief Reads back the timestamps of a frame whose command buffer has finished executing, returns whether new samples were added
+     */
+    bool collect(VkDevice device, vk_frame_queries& frame);
+
+    /**
+     *  @brief Resets the frame's queries, must be recorded before any scope of the frame
+     */
+    void begin_frame(VkCommandBuffer cmd, vk_frame_queries& frame);
+    void begin_gpu_scope(VkCommandBuffer cmd, vk_frame_queries& frame, const char* name);
+    void end_gpu_scope(VkCommandBuffer cmd, vk_frame_queries& frame);
+
+    void add_cpu_sample(const char* name, f64 ms);
+
+    /**
+     *  @brief Returns min/avg/p99 over the rolling history of a scope, all values are in milliseconds
+     */
+    vk_profiler_stats get_stats(const std::string& name) const;
+    std::vector<std::string> get_scope_names() const;
+
+    /**
+     *  @brief Returns the most recent sample of a scope in milliseconds, or a negative value if it has none yet
+     */
+    f64 get_last_sample(const std::string& name) const;
+
+    /**
+     *  @brief Writes the stats of every scope to a csv file
+     */
+    bool dump_csv(const char* file_path) const;
+
+private:
+    struct scope_history {
+        bool is_gpu;
+        std::array<f64, PROFILER_HISTORY_SIZE> samples;
+        u32 head;
+        u32 count;
+    };
+
+    void add_sample(const char* name, f64 ms, bool is_gpu);
+
+    std::unordered_map<std::string, scope_history> history;
+
+    bool gpu_supported = false;
+    f64 timestamp_period; // Nanoseconds per timestamp tick
+    u64 timestamp_mask;
+};
+
+// Measures the time between construction and destruction as a cpu sample
+struct vk_cpu_scope {
+    vk_cpu_scope(vk_profiler& profiler, const char* name) : profiler(profiler), name(name) {
+        start = std::chrono::high_resolution_clock::now();
+    }
+
+    ~vk_cpu_scope() {
+        auto end = std::chrono::high_resolution_clock::now();
+        profiler.add_cpu_sample(name, std::chrono::duration<f64, std::milli>(end - start).count());
+    }
+
+    vk_profiler& profiler;
+    const char* name;
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+#endif //VK_PROFILER_H
@@ -0,0 +1,321 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_render_graph.h"
+
+#include <algorithm>
+
+#include "vk_initializers.h"
+
+struct graph_usage_info {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    bool is_write;
+};
+
+// Indexed by vk_graph_usage
+static constexpr graph_usage_info GRAPH_USAGE_INFOS[GRAPH_USAGE_COUNT] = {
+    { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true },
+    { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+      VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, true },
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, false },
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false },
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+    { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+    { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false },
+    { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true },
+};
+
+void vk_render_graph::init(VkDevice device, VmaAllocator allocator, vk_bindless_heap* heap, std::function<void(std::function<void()>&&)>&& retire) {
+    transients.init(device, allocator, heap);
+    this->retire = std::move(retire);
+}
+
+void vk_render_graph::destroy() {
+    transients.destroy();
+    transient_images = {};
+}
+
+void vk_render_graph::reset() {
+    passes.clear();
+    resources.clear();
+    culled_pass_count = 0;
+}
+
+u32 vk_render_graph::import_image(const char* name, const vk_graph_image& image) {
+    resources.push_back({ name, image, false, VK_IMAGE_LAYOUT_UNDEFINED, false, {}, 0 });
+    return (u32)resources.size() - 1;
+}
+
+u32 vk_render_graph::create_image(const char* name, const vk_transient_image_desc& desc) {
+    resources.push_back({ name, { VK_NULL_HANDLE, desc.aspect, VK_IMAGE_LAYOUT_UNDEFINED }, false, VK_IMAGE_LAYOUT_UNDEFINED, true, desc, 0 });
+    return (u32)resources.size() - 1;
+}
+
+u32 vk_render_graph::create_token(const char* name) {
+    resources.push_back({ name, { VK_NULL_HANDLE, 0, VK_IMAGE_LAYOUT_UNDEFINED }, false, VK_IMAGE_LAYOUT_UNDEFINED, false, {}, 0 });
+    return (u32)resources.size() - 1;
+}
+
+void vk_render_graph::mark_output(u32 resource, VkImageLayout final_layout) {
+    if(resources[resource].is_transient) {
+        LOG_THROW("Render graph: transient image " + std::string(resources[resource].name) + " can't be an output");
+    }
+
+    resources[resource].is_output = true;
+    resources[resource].final_layout = final_layout;
+}
+
+vk_graph_pass& vk_render_graph::add_pass(const char* name, std::function<void(VkCommandBuffer)>&& record) {
+    vk_graph_pass& pass = passes.emplace_back();
+    pass.name = name;
+    pass.record = std::move(record);
+
+    return pass;
+}
+
+void vk_render_graph::cull_passes() {
+    std::vector<bool> needed(resources.size(), false);
+    for(u32 i = 0; i < resources.size(); i++) {
+        needed[i] = resources[i].is_output;
+    }
+
+    // Walking backwards every consumer is seen before its producers. A kept pass needs everything it touches,
+    // attachments that get loaded included, so writers in front of it stay as well
+    culled_pass_count = 0;
+    for(auto pass = passes.rbegin(); pass != passes.rend(); ++pass) {
+        bool writes_needed = false;
+        for(const auto& use : pass->uses) {
+            writes_needed |= GRAPH_USAGE_INFOS[use.usage].is_write && needed[use.resource];
+        }
+
+        pass->culled = !pass->has_side_effects && !writes_needed;
+        if(pass->culled) {
+            culled_pass_count++;
+            continue;
+        }
+
+        for(const auto& use : pass->uses) {
+            needed[use.resource] = true;
+        }
+    }
+}
+
+void vk_render_graph::allocate_transients() {
+    std::vector<vk_transient_request> requests;
+    std::vector<u32> request_resources;
+
+    for(u32 i = 0; i < resources.size(); i++) {
+        if(!resources[i].is_transient) continue;
+
+        u32 first_pass = ~0u;
+        u32 last_pass = 0;
+
+        u32 pass_index = 0;
+        for(const vk_graph_pass& pass : passes) {
+            if(!pass.culled) {
+                for(const auto& use : pass.uses) {
+                    if(use.resource != i) continue;
+
+                    first_pass = std::min(first_pass, pass_index);
+                    last_pass = std::max(last_pass, pass_index);
+                }
+            }
+
+            pass_index++;
+        }
+
+        // Only culled passes use it, it doesn't need memory
+        if(first_pass == ~0u) continue;
+
+        resources[i].transient = (u32)requests.size();
+        requests.push_back({ resources[i].desc, first_pass, last_pass });
+        request_resources.push_back(i);
+    }
+
+    transient_images = transients.allocate(requests, retire);
+
+    for(u32 i = 0; i < request_resources.size(); i++) {
+        resources[request_resources[i]].image.image = transient_images[i].image;
+    }
+}
+
+void vk_render_graph::execute(VkCommandBuffer cmd) {
+    cull_passes();
+    allocate_transients();
+
+    std::vector<resource_state> states(resources.size());
+    for(u32 i = 0; i < resources.size(); i++) {
+        const vk_graph_image& image = resources[i].image;
+        resource_state& state = states[i];
+
+        state = { image.layout, image.wait_stage, 0, 0, 0 };
+
+        // The first use has to wait for the last frame's uses, barriers cover earlier submissions on the queue too.
+        // Transient images wait for whoever used their memory before them instead, see below
+        if(image.image != VK_NULL_HANDLE && !resources[i].is_transient) {
+            auto last = last_states.find(image.image);
+            state.write_stages |= last != last_states.end() ? last->second.write_stages : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            state.write_access = last != last_states.end() ? last->second.write_access : VK_ACCESS_2_MEMORY_WRITE_BIT;
+        }
+    }
+
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+    VkMemoryBarrier2 memory_barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+
+    auto flush_barriers = [&]() {
+        bool has_memory_barrier = memory_barrier.srcStageMask != 0 || memory_barrier.dstStageMask != 0;
+        if(image_barriers.empty() && !has_memory_barrier) return;
+
+        VkDependencyInfo dep_info = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+        dep_info.pNext = nullptr;
+        dep_info.memoryBarrierCount = has_memory_barrier ? 1 : 0;
+        dep_info.pMemoryBarriers = &memory_barrier;
+        dep_info.imageMemoryBarrierCount = (u32)image_barriers.size();
+        dep_info.pImageMemoryBarriers = image_barriers.data();
+
+        vkCmdPipelineBarrier2(cmd, &dep_info);
+
+        image_barriers.clear();
+        memory_barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    };
+
+    auto add_barrier = [&](u32 resource_index, VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages,
+                           VkAccessFlags2 dst_access, VkImageLayout new_layout) {
+        const vk_graph_image& image = resources[resource_index].image;
+
+        if(image.image == VK_NULL_HANDLE) {
+            memory_barrier.srcStageMask |= src_stages;
+            memory_barrier.srcAccessMask |= src_access;
+            memory_barrier.dstStageMask |= dst_stages;
+            memory_barrier.dstAccessMask |= dst_access;
+            return;
+        }
+
+        VkImageMemoryBarrier2 barrier = {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+        barrier.pNext = nullptr;
+        barrier.srcStageMask = src_stages;
+        barrier.srcAccessMask = src_access;
+        barrier.dstStageMask = dst_stages;
+        barrier.dstAccessMask = dst_access;
+        barrier.oldLayout = states[resource_index].layout;
+        barrier.newLayout = new_layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image.image;
+        barrier.subresourceRange = vkinit::image_subresource_range(image.aspect);
+
+        image_barriers.push_back(barrier);
+    };
+
+    // Stages and writes that touched each transient memory block so far this frame. An image taking over memory has to wait for them,
+    // the first one in a block waits for everything before it, last frame's images in the same memory included
+    std::vector<VkPipelineStageFlags2> block_stages;
+    std::vector<VkAccessFlags2> block_writes;
+    std::vector<bool> first_use(resources.size(), true);
+
+    for(vk_graph_pass& pass : passes) {
+        if(pass.culled) continue;
+
+        for(const auto& use : pass.uses) {
+            const graph_usage_info& info = GRAPH_USAGE_INFOS[use.usage];
+            resource_state& state = states[use.resource];
+
+            if(resources[use.resource].is_transient) {
+                u32 block = transient_images[resources[use.resource].transient].memory_block;
+                if(block >= block_stages.size()) {
+                    block_stages.resize(block + 1, 0);
+                    block_writes.resize(block + 1, 0);
+                }
+
+                if(first_use[use.resource]) {
+                    // Nothing used the block yet this frame, it still holds last frame's writes
+                    bool block_used = block_stages[block] != 0;
+                    state.write_stages = block_used ? block_stages[block] : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+                    state.write_access = block_used ? block_writes[block] : VK_ACCESS_2_MEMORY_WRITE_BIT;
+                    first_use[use.resource] = false;
+                }
+
+                block_stages[block] |= info.stages;
+                if(info.is_write) {
+                    block_writes[block] |= info.access;
+                }
+            }
+
+            bool is_image = resources[use.resource].image.image != VK_NULL_HANDLE;
+            bool layout_change = is_image && state.layout != info.layout;
+
+            if(info.is_write) {
+                // Write after write and write after read, the reads only need an execution dependency
+                VkPipelineStageFlags2 src_stages = state.write_stages | state.read_stages;
+                if(src_stages != 0 || layout_change) {
+                    add_barrier(use.resource, src_stages, state.write_access, info.stages, info.access, is_image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED);
+                }
+
+                state.write_stages = info.stages;
+                state.write_access = info.access;
+                state.read_stages = 0;
+                state.read_access = 0;
+            } else {
+                // Reads only wait when the last write isn't visible to them yet
+                bool already_visible = (info.stages & ~state.read_stages) == 0 && (info.access & ~state.read_access) == 0;
+                if(layout_change || (state.write_stages != 0 && !already_visible)) {
+                    VkPipelineStageFlags2 src_stages = layout_change ? state.write_stages | state.read_stages : state.write_stages;
+                    add_barrier(use.resource, src_stages, state.write_access, info.stages, info.access, is_image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED);
+
+                    // A layout transition is a write of its own, later readers have to wait for it
+                    if(layout_change) {
+                        state.write_stages = info.stages;
+                        state.write_access = 0;
+                        state.read_stages = 0;
+                        state.read_access = 0;
+                    }
+                }
+
+                state.read_stages |= info.stages;
+                state.read_access |= info.access;
+            }
+
+            if(is_image) {
+                state.layout = info.layout;
+            }
+        }
+
+        flush_barriers();
+
+        pass.record(cmd);
+    }
+
+    // Outputs leave in the layout the code after the graph expects, presenting needs no further access
+    for(u32 i = 0; i < resources.size(); i++) {
+        const resource& res = resources[i];
+        if(!res.is_output || res.image.image == VK_NULL_HANDLE || states[i].layout == res.final_layout) continue;
+
+        bool is_present = res.final_layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        add_barrier(i, states[i].write_stages | states[i].read_stages, states[i].write_access,
+                    is_present ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                    is_present ? VK_ACCESS_2_NONE : VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT, res.final_layout);
+
+        // Whatever reads the output later is outside the graph, so the next frame waits for everything
+        if(!is_present) {
+            states[i].write_stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            states[i].write_access = VK_ACCESS_2_MEMORY_WRITE_BIT;
+        }
+    }
+
+    flush_barriers();
+
+    // Only the images of this frame, the ones that were resized away don't come back
+    last_states.clear();
+    for(u32 i = 0; i < resources.size(); i++) {
+        if(resources[i].image.image == VK_NULL_HANDLE || resources[i].is_transient) continue;
+
+        // The next frame's first use is a write after all of these, layout transitions included
+        resource_state& last = last_states[resources[i].image.image];
+        last.write_stages |= states[i].write_stages | states[i].read_stages;
+        last.write_access |= states[i].write_access;
+    }
+}
@@ -0,0 +1,157 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_RENDER_GRAPH_H
+#define VK_RENDER_GRAPH_H
+
+#include <unordered_map>
+
+#include "vk_transient_allocator.h"
+#include "vk_types.h"
+
+// How a pass touches a resource, decides the stages, accesses and image layout of the barriers around it
+enum vk_graph_usage : u32 {
+    GRAPH_USAGE_COLOR_ATTACHMENT = 0,
+    GRAPH_USAGE_DEPTH_ATTACHMENT,
+    GRAPH_USAGE_DEPTH_SAMPLED,  // Depth read by a compute shader
+    GRAPH_USAGE_COMPUTE_READ,   // Storage or sampled read by a compute shader, images stay in GENERAL
+    GRAPH_USAGE_COMPUTE_WRITE,  // Storage write by a compute shader, images stay in GENERAL
+    GRAPH_USAGE_INDIRECT_READ,
+    GRAPH_USAGE_TRANSFER_SRC,
+    GRAPH_USAGE_TRANSFER_DST,
+    GRAPH_USAGE_COUNT,
+};
+
+// An image living outside the graph, it gets used for one frame
+struct vk_graph_image {
+    VkImage image;
+    VkImageAspectFlags aspect;
+    VkImageLayout layout; // Layout at the start of the frame, UNDEFINED throws the contents away
+    VkPipelineStageFlags2 wait_stage = VK_PIPELINE_STAGE_2_NONE; // Stage a semaphore wait already covers, the first use chains onto it
+};
+
+struct vk_graph_pass {
+    struct resource_use {
+        u32 resource;
+        vk_graph_usage usage;
+    };
+
+    const char* name;
+    std::function<void(VkCommandBuffer)> record;
+    std::vector<resource_use> uses;
+    bool has_side_effects = false;
+    bool culled = false;
+
+    /**
+     *  @brief Declares that the pass touches a resource, a usage that writes makes the pass a producer of it
+     */
+    vk_graph_pass& use(u32 resource, vk_graph_usage usage) {
+        uses.push_back({ resource, usage });
+        return *this;
+    }
+
+    /**
+     *  @brief Keeps the pass even when nothing in the graph reads what it writes
+     */
+    vk_graph_pass& keep() {
+        has_side_effects = true;
+        return *this;
+    }
+};
+
+// Passes declare the resources they read and write, the graph drops passes whose results nobody uses and places
+// the barriers between the rest. All barriers in front of a pass go out in one vkCmdPipelineBarrier2, scoped to the stages actually involved.
+// Images created by the graph only live from their first to their last pass, ones that are never needed at the same time share memory
+class vk_render_graph {
+public:
+    /**
+     *  @brief retire frees the transient images of a frame once the gpu is done with them
+     */
+    void init(VkDevice device, VmaAllocator allocator, vk_bindless_heap* heap, std::function<void(std::function<void()>&&)>&& retire);
+
+    /**
+     *  @brief Frees the transient images right away, the gpu has to be done with them
+     */
+    void destroy();
+
+    /**
+     *  @brief Starts a new frame, the passes and resources of the last one are dropped
+     */
+    void reset();
+
+    u32 import_image(const char* name, const vk_graph_image& image);
+
+    /**
+     *  @brief An image that only exists while the frame's passes use it, its contents are undefined at the first use.
+     *  It can't be an output, the memory gets reused by later passes of the frame
+     */
+    u32 create_image(const char* name, const vk_transient_image_desc& desc);
+
+    /**
+     *  @brief The image behind a resource made by create_image, only valid while its passes are recorded
+     */
+    const vk_transient_image& get_image(u32 resource) const { return transient_images[resources[resource].transient]; }
+
+    /**
+     *  @brief A resource that only orders passes, like the buffers the gpu scene culls into. Its barriers are global memory barriers
+     */
+    u32 create_token(const char* name);
+
+    /**
+     *  @brief The resource is used after the graph, passes writing it are never culled. Images end up in final_layout
+     */
+    void mark_output(u32 resource, VkImageLayout final_layout);
+
+    /**
+     *  @brief Adds a pass, passes run in the order they were added. The reference is valid until reset
+     */
+    vk_graph_pass& add_pass(const char* name, std::function<void(VkCommandBuffer)>&& record);
+
+    /**
+     *  @brief Culls the unused passes and records the rest with their barriers
+     */
+    void execute(VkCommandBuffer cmd);
+
+    u32 get_culled_pass_count() const { return culled_pass_count; }
+
+    const vk_transient_allocator& get_transient_allocator() const { return transients; }
+private:
+    struct resource {
+        const char* name;
+        vk_graph_image image; // image is VK_NULL_HANDLE for tokens, and for transient images until they get allocated
+        bool is_output;
+        VkImageLayout final_layout;
+
+        bool is_transient;
+        vk_transient_image_desc desc;
+        u32 transient; // Index into transient_images
+    };
+
+    // Where a resource stands while the graph is recorded
+    struct resource_state {
+        VkImageLayout layout;
+        VkPipelineStageFlags2 write_stages; // Last write, or whatever has to finish before the next use
+        VkAccessFlags2 write_access;
+        VkPipelineStageFlags2 read_stages; // Stages and accesses that already saw the last write
+        VkAccessFlags2 read_access;
+    };
+
+    void cull_passes();
+
+    // Sizes the lifetimes of the transient images the remaining passes use and gets them their memory
+    void allocate_transients();
+
+    std::deque<vk_graph_pass> passes;
+    std::vector<resource> resources;
+    u32 culled_pass_count = 0;
+
+    // Stages every image was last used in by the previous frame and its last writes, the first barrier of the next frame waits for them
+    std::unordered_map<VkImage, resource_state> last_states;
+
+    vk_transient_allocator transients;
+    std::span<const vk_transient_image> transient_images;
+    std::function<void(std::function<void()>&&)> retire;
+};
+
+#endif //VK_RENDER_GRAPH_H
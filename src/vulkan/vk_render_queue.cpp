@@ -0,0 +1,87 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_render_queue.h"
+
+// Key layout, most significant first: pipeline, material, mesh
+constexpr u32 RENDER_QUEUE_PIPELINE_BITS = 8;
+constexpr u32 RENDER_QUEUE_MATERIAL_BITS = 24;
+constexpr u32 RENDER_QUEUE_MESH_BITS = 32;
+
+static_assert(RENDER_QUEUE_PIPELINE_BITS + RENDER_QUEUE_MATERIAL_BITS + RENDER_QUEUE_MESH_BITS == 64);
+
+void vk_render_queue::submit(u32 pipeline, u32 material, const vk_gpu_mesh_buffers& mesh, const glm::mat4& world_matrix) {
+    if(pipeline >= (1u << RENDER_QUEUE_PIPELINE_BITS) || material >= (1u << RENDER_QUEUE_MATERIAL_BITS)) {
+        LOG_THROW("Render queue: pipeline or material index out of range");
+    }
+
+    u64 key = ((u64)pipeline << (RENDER_QUEUE_MATERIAL_BITS + RENDER_QUEUE_MESH_BITS))
+              | ((u64)material << RENDER_QUEUE_MESH_BITS)
+              | (u64)mesh.mesh_id;
+
+    entries.push_back({ key, (u32)items.size() });
+    items.push_back({ mesh.index_buffer.buffer, mesh.index_count, mesh.vertex_buffer_address, world_matrix });
+}
+
+void vk_render_queue::build(vk_gpu_instance_data* instances) {
+    radix_sort();
+
+    batches.clear();
+
+    for(u32 i = 0; i < entries.size(); i++) {
+        const queued_item& item = items[entries[i].item];
+        instances[i].world_matrix = item.world_matrix;
+
+        // Equal keys mean the same pipeline, material and mesh, so the instance joins the batch before it
+        if(i > 0 && entries[i].key == entries[i - 1].key) {
+            batches.back().instance_count++;
+            continue;
+        }
+
+        vk_draw_batch batch{};
+        batch.pipeline = (u32)(entries[i].key >> (RENDER_QUEUE_MATERIAL_BITS + RENDER_QUEUE_MESH_BITS));
+        batch.material = (u32)(entries[i].key >> RENDER_QUEUE_MESH_BITS) & ((1u << RENDER_QUEUE_MATERIAL_BITS) - 1);
+        batch.index_buffer = item.index_buffer;
+        batch.index_count = item.index_count;
+        batch.vertex_buffer = item.vertex_buffer;
+        batch.first_instance = i;
+        batch.instance_count = 1;
+
+        batches.push_back(batch);
+    }
+}
+
+void vk_render_queue::clear() {
+    items.clear();
+    entries.clear();
+    batches.clear();
+}
+
+void vk_render_queue::radix_sort() {
+    // LSD radix sort on 8 bit digits, stable so instances keep their submission order within a batch
+    scratch.resize(entries.size());
+
+    for(u32 shift = 0; shift < 64; shift += 8) {
+        std::array<u32, 256> counts{};
+        for(const sort_entry& entry : entries) {
+            counts[(entry.key >> shift) & 0xFF]++;
+        }
+
+        // Most digits are the same for every entry (few pipelines and materials), those passes wouldn't move anything
+        if(counts[(entries.empty() ? 0 : entries[0].key >> shift) & 0xFF] == entries.size()) continue;
+
+        u32 offset = 0;
+        for(u32& count : counts) {
+            u32 bucket_size = count;
+            count = offset;
+            offset += bucket_size;
+        }
+
+        for(const sort_entry& entry : entries) {
+            scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+
+        entries.swap(scratch);
+    }
+}
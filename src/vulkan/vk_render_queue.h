@@ -0,0 +1,65 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_RENDER_QUEUE_H
+#define VK_RENDER_QUEUE_H
+
+#include "vk_types.h"
+
+// Consecutive instances of one mesh drawn with one material, a single instanced draw
+struct vk_draw_batch {
+    u32 pipeline;
+    u32 material;
+    VkBuffer index_buffer;
+    u32 index_count;
+    VkDeviceAddress vertex_buffer;
+    u32 first_instance; // Index of the batch's first entry in the instance buffer
+    u32 instance_count;
+};
+
+// Collects the draws of a frame and sorts them by pipeline, material and mesh, so identical meshes collapse into instanced draws
+class vk_render_queue {
+public:
+    /**
+     *  @brief Queues an instance, pipeline and material are small indices that only decide the order and the batching
+     */
+    void submit(u32 pipeline, u32 material, const vk_gpu_mesh_buffers& mesh, const glm::mat4& world_matrix);
+
+    /**
+     *  @brief Sorts the queued instances, writes them into instances in draw order and builds the batches.
+     *  instances has to hold at least size() entries
+     */
+    void build(vk_gpu_instance_data* instances);
+
+    const std::vector<vk_draw_batch>& get_batches() const { return batches; }
+
+    u32 size() const { return (u32)items.size(); }
+    bool empty() const { return items.empty(); }
+
+    void clear();
+
+private:
+    struct queued_item {
+        VkBuffer index_buffer;
+        u32 index_count;
+        VkDeviceAddress vertex_buffer;
+        glm::mat4 world_matrix;
+    };
+
+    // Sort key in the high bits, index into items in the low ones
+    struct sort_entry {
+        u64 key;
+        u32 item;
+    };
+
+    void radix_sort();
+
+    std::vector<queued_item> items;
+    std::vector<sort_entry> entries;
+    std::vector<sort_entry> scratch;
+
+    std::vector<vk_draw_batch> batches;
+};
+
+#endif //VK_RENDER_QUEUE_H
@@ -4,7 +4,9 @@
 
 #include "vk_renderer.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <thread>
 
 #define VMA_IMPLEMENTATION
@@ -23,6 +25,7 @@
 #include "imgui/backends/imgui_impl_vulkan.h"
 
 #include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
 
 #define SHOULD_USE_VALIDATION_LAYERS true
 
@@ -43,14 +46,31 @@ void vk_renderer::init_backend() {
     // Initialize synchronization structures
     init_sync_structures();
 
+    // Initialize the render scale controller, it starts out at full resolution
+    resolution_scaler.init(vk_resolution_scaler_config{ .target_frame_ms = config.target_frame_ms, .min_scale = config.min_render_scale });
+    resolution_scaler.set_enabled(config.dynamic_resolution);
+
+    // Initialize the compute queue resources, if we got a dedicated compute queue
+    if(use_async_compute) {
+        init_async_compute();
+    }
+
     // Initialize descriptors
     init_descriptors();
 
+    // Initialize the buffers of the gpu driven scene
+    init_gpu_scene();
+
     // Initialize pipelines
     init_pipelines();
 
-    // Initialize imgui
-    init_imgui();
+    // Upload the meshes every frame draws
+    init_default_data();
+
+    // Initialize imgui, there is no window to take input from when running headless
+    if(!is_headless()) {
+        init_imgui();
+    }
 
     LOG_DEBUG("Vulkan Backend successfully initialized!");
 }
@@ -61,21 +81,48 @@ void vk_renderer::destroy() {
     // Wait for the device to finish all operations before destroying
     vkDeviceWaitIdle(logical_device);
 
+    // Let the workers finish so every pipeline they built gets installed and destroyed with the rest
+    shader_watcher.destroy();
+    pipeline_compiler.destroy();
+    install_ready_pipelines(true);
+
+    if(use_streaming) {
+        streamer.destroy();
+    }
+
+    uploader.destroy();
+    frame_deletion_queue.flush();
     main_deletion_queue.flush();
 
+    pipeline_cache.save(logical_device);
+    pipeline_cache.destroy(logical_device);
+    shader_registry.destroy();
+
+    parallel_recorder.destroy();
+
     for(auto& frame : frames) {
         vkDestroyCommandPool(logical_device, frame.command_pool, nullptr);
+        profiler.destroy_frame(logical_device, frame.queries);
 
-        vkDestroyFence(logical_device, frame.render_fence, nullptr);
         vkDestroySemaphore(logical_device, frame.swapchain_semaphore, nullptr);
         vkDestroySemaphore(logical_device, frame.render_semaphore, nullptr);
+    }
 
-        frame.del_queue.flush();
+    graphics_timeline.destroy(logical_device);
+
+    if(use_async_compute) {
+        for(auto& frame : frames) {
+            vkDestroyCommandPool(logical_device, frame.compute_command_pool, nullptr);
+        }
+
+        compute_timeline.destroy(logical_device);
     }
 
-    destroy_swapchain();
+    if(!is_headless()) {
+        destroy_swapchain();
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
 
     vkDestroyDevice(logical_device, nullptr);
     vkb::destroy_debug_utils_messenger(instance, debug_messenger);
@@ -87,6 +134,19 @@ void vk_renderer::destroy() {
 void vk_renderer::draw_frame() {
     // if(!should_render) return;
 
+    if(is_headless()) {
+        draw_frame_headless();
+        return;
+    }
+
+    // Rebuild the swapchain before starting the frame. A minimized window has nothing to render into, so we skip the frame entirely
+    if(resize_requested && !resize_swapchain()) {
+        render_queue.clear();
+        return;
+    }
+
+    vk_cpu_scope frame_scope(profiler, "cpu_frame");
+
     // TODO: Throw out ImGui from here
 
     // Draw ImGui
@@ -99,90 +159,463 @@ void vk_renderer::draw_frame() {
 
     ImGui::Render();
 
-    // Wait for the gpu to finish rendering the last frame. Timeout of 1 second
-    VK_CHECK(vkWaitForFences(logical_device, 1, &get_current_frame().render_fence, true, 100000000));
-
-    get_current_frame().del_queue.flush();
+    begin_frame();
 
     u32 swapchain_image_index;
-    VK_CHECK(vkAcquireNextImageKHR(logical_device, swapchain, 100000000, get_current_frame().swapchain_semaphore, nullptr, &swapchain_image_index));
+    {
+        vk_cpu_scope scope(profiler, "acquire");
+        VkResult res = vkAcquireNextImageKHR(logical_device, swapchain, 100000000, get_current_frame().swapchain_semaphore, nullptr, &swapchain_image_index);
+
+        // Out of date swapchains can't be rendered to, so we retry next frame with a new one.
+        // A suboptimal one still signalled the semaphore, so we finish this frame first
+        if(res == VK_ERROR_OUT_OF_DATE_KHR) {
+            resize_requested = true;
+            render_queue.clear();
+            return;
+        }
+
+        if(res == VK_SUBOPTIMAL_KHR) {
+            resize_requested = true;
+        } else {
+            VK_CHECK(res);
+        }
+    }
+
+    // Kick off the background as early as possible so it overlaps the previous frame's graphics work
+    if(use_async_compute) {
+        submit_async_background();
+    }
+
+    VkCommandBuffer cmd = get_current_frame().command_buffer;
+
+    record_frame(cmd, [this, swapchain_image_index](u32 draw) {
+        // The acquire semaphore is waited on at the color attachment output stage, the first use of the image chains onto it
+        u32 swapchain_image = render_graph.import_image("swapchain_image", { swapchain_images[swapchain_image_index], VK_IMAGE_ASPECT_COLOR_BIT,
+                                                                             VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT });
+
+        // execute a copy from the draw image into the swapchain
+        add_graph_pass("blit", [this, swapchain_image_index](VkCommandBuffer cmd) {
+            vkutil::copy_image_to_image(cmd, draw_image.image, swapchain_images[swapchain_image_index], draw_extent, swapchain_extent);
+        }).use(draw, GRAPH_USAGE_TRANSFER_SRC).use(swapchain_image, GRAPH_USAGE_TRANSFER_DST);
 
-    VK_CHECK(vkResetFences(logical_device, 1, &get_current_frame().render_fence));
+        //draw imgui into the swapchain image
+        add_graph_pass("imgui", [this, swapchain_image_index](VkCommandBuffer cmd) {
+            draw_imgui(cmd, swapchain_image_views[swapchain_image_index]);
+        }).use(swapchain_image, GRAPH_USAGE_COLOR_ATTACHMENT);
+
+        render_graph.mark_output(swapchain_image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    });
+
+    {
+        vk_cpu_scope scope(profiler, "submit");
+
+        // We want to wait on the present_semaphore, as that semaphore is signaled when the swapchain is ready
+        // We will signal the render_semaphore, to signal that rendering has finished
+        submit_graphics(cmd, get_current_frame().swapchain_semaphore, get_current_frame().render_semaphore);
+    }
+
+    {
+        vk_cpu_scope scope(profiler, "present");
+
+        // Prepare present
+        // This will put the image we just rendered to into the visible window.
+        // We want to wait on the render_semaphore for that, as its necessary that drawing commands have finished before the image is displayed to the user
+        VkPresentInfoKHR present_info = {};
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.pNext = nullptr;
+        present_info.pSwapchains = &swapchain;
+        present_info.swapchainCount = 1;
+
+        present_info.pWaitSemaphores = &get_current_frame().render_semaphore;
+        present_info.waitSemaphoreCount = 1;
+
+        present_info.pImageIndices = &swapchain_image_index;
+
+        VkResult res = vkQueuePresentKHR(graphics_queue, &present_info);
+        if(res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
+            resize_requested = true;
+        } else {
+            VK_CHECK(res);
+        }
+    }
+
+    frame_number++;
+}
+
+void vk_renderer::draw_frame_headless() {
+    // Same as draw_frame, minus ImGui and the swapchain. The frame ends with the draw image ready to be read back
+    vk_cpu_scope frame_scope(profiler, "cpu_frame");
+
+    begin_frame();
+
+    if(use_async_compute) {
+        submit_async_background();
+    }
 
     VkCommandBuffer cmd = get_current_frame().command_buffer;
 
+    record_frame(cmd, [this](u32 draw) {
+        // Leave the draw image as a transfer source so the caller can copy it out
+        render_graph.mark_output(draw, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    });
+
+    {
+        vk_cpu_scope scope(profiler, "submit");
+
+        // No swapchain to wait on, the graphics timeline is enough to pace the frames
+        submit_graphics(cmd, VK_NULL_HANDLE, VK_NULL_HANDLE);
+    }
+
+    frame_number++;
+}
+
+void vk_renderer::record_frame(VkCommandBuffer cmd, const std::function<void(u32)>& add_output_passes) {
+    vk_cpu_scope scope(profiler, "record");
+
     // Now that we are sure that the commands finished executing, we can safely reset the command buffer to begin recording again.
     VK_CHECK(vkResetCommandBuffer(cmd, 0));
 
     // Begin the command buffer recording. We will use this command buffer exactly once, so we want to let vulkan know that
     VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-    draw_extent.width = draw_image.image_extent.width;
-    draw_extent.height = draw_image.image_extent.height;
-
     // Begin the command buffer
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
-    // transition our main draw image into general layout so we can write into it
-    // we will overwrite it all so we dont care about what was the older layout
-    vkutil::transition_image(cmd, draw_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    profiler.begin_frame(cmd, get_current_frame().queries);
+    profiler.begin_gpu_scope(cmd, get_current_frame().queries, "gpu_frame");
+
+    u32 draw = build_scene_graph(cmd);
+
+    // Everything after the draw image differs between presenting and headless frames, including the graph's output
+    add_output_passes(draw);
+    render_graph.execute(cmd);
+
+    // The cpu reads the virtual texture feedback back once this frame retired
+    virtual_texture_cache.record_feedback_barrier(cmd);
 
-    draw_background(cmd);
+    render_queue.clear();
 
-    vkutil::transition_image(cmd, draw_image.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    profiler.end_gpu_scope(cmd, get_current_frame().queries);
 
-    draw_geometry(cmd);
+    //finalize the command buffer (we can no longer add commands, but it can now be executed)
+    VK_CHECK(vkEndCommandBuffer(cmd));
+}
+
+void vk_renderer::begin_frame() {
+    {
+        vk_cpu_scope scope(profiler, "fence_wait");
 
-    //transition the draw image and the swapchain image into their correct transfer layouts
-    vkutil::transition_image(cmd, draw_image.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    vkutil::transition_image(cmd, swapchain_images[swapchain_image_index], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        // Wait for the gpu to finish the frame that last used this slot. Timeout of 1 second
+        // The graphics work of that frame waited on its background, so the compute side is done too
+        VK_CHECK(graphics_timeline.wait(logical_device, get_current_frame().timeline_value, 1000000000));
+    }
+
+    memory_budget.update((u32)frame_number);
 
-    // execute a copy from the draw image into the swapchain
-    vkutil::copy_image_to_image(cmd, draw_image.image, swapchain_images[swapchain_image_index], draw_extent, swapchain_extent);
+    // Sets allocated by the frame that last used this slot aren't needed anymore
+    get_current_frame().frame_descriptors.clear_pools(logical_device);
 
-    // set swapchain image layout to Attachment Optimal so we can draw it
-    vkutil::transition_image(cmd, swapchain_images[swapchain_image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    // Same for the secondary command buffers it recorded
+    parallel_recorder.reset_frame(frame_number % frames.size());
 
-    //draw imgui into the swapchain image
-    draw_imgui(cmd, swapchain_image_views[swapchain_image_index]);
+    // The frame is done on the gpu, so its timestamps can be read back
+    if(profiler.collect(logical_device, get_current_frame().queries) && resolution_scaler.is_enabled()) {
+        resolution_scaler.update(profiler.get_last_sample("gpu_frame"), get_current_frame().render_scale);
+    }
 
-    // set swapchain image layout to Present so we can draw it
-    vkutil::transition_image(cmd, swapchain_images[swapchain_image_index], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // Retire everything the gpu is done with, not only what this slot queued
+    frame_deletion_queue.collect(graphics_timeline.get_completed_value(logical_device));
+
+    // Submit everything uploaded since the last frame in one batch, it runs before this frame on the same queue
+    gpu_scene.sync();
+
+    uploader.collect();
+
+    // Read back what the slot's last frame sampled and queue the virtual texture pages the loader finished
+    virtual_texture_cache.update(frame_number % frames.size());
+
+    uploader.flush();
+
+    // Pick up what the streaming thread finished, the ownership acquires get recorded into this frame
+    if(use_streaming) {
+        vk_stream_completion completion;
+        while(streamer.poll(completion)) {
+            stream_acquires.push_back(std::move(completion));
+        }
+    }
+
+    // Rebuild pipelines whose shaders changed on disk, they get swapped in once ready like any other pipeline
+    if(config.hot_reload_shaders) {
+        reload_changed_shaders();
+    }
+
+    // Swap in pipelines the workers finished since the last frame
+    if(!pending_pipelines.empty()) {
+        install_ready_pipelines(false);
+
+        if(pending_pipelines.empty()) {
+            pipeline_cache.log_stats();
+        }
+    }
+
+    // The slot is idle, so this is the time to resize its background to a reallocated draw image.
+    // Only this slot ever touched its background, so its heap index can be rewritten in place
+    vk_frame_data& frame = get_current_frame();
+    if(frame.draw_image_generation != draw_image_generation) {
+        if(use_async_compute) {
+            destroy_background_image(frame);
+            create_background_image(frame);
+
+            bindless_heap.update_storage_image(frame.background_image_index, frame.background_image.image_view);
+        }
+
+        frame.draw_image_generation = draw_image_generation;
+    }
+
+    // The draw image only ever grows, we render into the part of it that matches the swapchain.
+    // The resolution scale shrinks that further, the blit to the swapchain upscales it back
+    VkExtent2D full_extent;
+    full_extent.width = std::min(swapchain_extent.width, draw_image.image_extent.width);
+    full_extent.height = std::min(swapchain_extent.height, draw_image.image_extent.height);
+
+    draw_extent = resolution_scaler.scale_extent(full_extent);
+    frame.render_scale = resolution_scaler.get_scale();
+}
+
+bool vk_renderer::resize_swapchain() {
+    int width, height;
+    glfwGetFramebufferSize((GLFWwindow*)window_ptr, &width, &height);
+
+    if(width == 0 || height == 0) {
+        return false;
+    }
+
+    // Frames in flight may still be presenting from the old swapchain, so it goes through the deletion queue instead of vkDeviceWaitIdle
+    VkSwapchainKHR old_swapchain = swapchain;
+    std::vector<VkImageView> old_image_views = swapchain_image_views;
+
+    create_swapchain((u32)width, (u32)height, old_swapchain);
+
+    retire([=]() {
+        for(auto& image_view : old_image_views) {
+            vkDestroyImageView(logical_device, image_view, nullptr);
+        }
+
+        vkDestroySwapchainKHR(logical_device, old_swapchain, nullptr);
+    });
+
+    // Grow the draw image to the high-water mark, shrinking windows keep using the bigger one
+    VkExtent3D extent = draw_image.image_extent;
+    if(swapchain_extent.width > extent.width || swapchain_extent.height > extent.height) {
+        // Frames in flight still read the old heap index, so the new image gets a fresh one
+        // The depth image follows on its own, the render graph reallocates its transients when their size changes
+        vk_allocated_image old_image = draw_image;
+        vk_depth_pyramid old_depth_pyramid = depth_pyramid;
+        u32 old_index = draw_image_index;
+        retire([=, this]() mutable {
+            bindless_heap.remove_storage_image(old_index);
+            old_depth_pyramid.destroy();
+
+            vkDestroyImageView(logical_device, old_image.image_view, nullptr);
+            vmaDestroyImage(allocator, old_image.image, old_image.allocation);
+        });
+
+        create_draw_image({std::max(extent.width, swapchain_extent.width), std::max(extent.height, swapchain_extent.height), 1});
+        draw_image_index = bindless_heap.add_storage_image(draw_image.image_view);
+
+        depth_pyramid.init(logical_device, allocator, &bindless_heap, {draw_image.image_extent.width, draw_image.image_extent.height});
+    }
+
+    resize_requested = false;
+    return true;
+}
+
+void vk_renderer::submit_async_background() {
+    vk_frame_data& frame = get_current_frame();
+    VkCommandBuffer cmd = frame.compute_command_buffer;
+
+    VK_CHECK(vkResetCommandBuffer(cmd, 0));
+
+    VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+    vkutil::transition_image(cmd, frame.background_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+    bindless_heap.bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+    draw_background(cmd, frame.background_image_index);
+
+    // The graphics queue copies the background into the draw image
+    vkutil::transition_image(cmd, frame.background_image.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 
-    //finalize the command buffer (we can no longer add commands, but it can now be executed)
     VK_CHECK(vkEndCommandBuffer(cmd));
 
-    // Prepare the submission to the queue
-    // We want to wait on the present_semaphore, as that semaphore is signaled when the swapchain is ready
-    // We will signal the render_semaphore, to signal that rendering has finished
+    frame.compute_timeline_value = compute_timeline.advance();
+
     VkCommandBufferSubmitInfo cmd_submit_info = vkinit::command_buffer_submit_info(cmd);
+    VkSemaphoreSubmitInfo signal_info = compute_timeline.submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.compute_timeline_value);
+
+    VkSubmitInfo2 submit_info = vkinit::submit_info(&cmd_submit_info, &signal_info, nullptr);
+
+    VK_CHECK(vkQueueSubmit2(compute_queue, 1, &submit_info, nullptr));
+}
+
+void vk_renderer::submit_graphics(VkCommandBuffer cmd, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore) {
+    // Besides the optional binary semaphores we always signal the graphics timeline, so the cpu knows when it can reuse this frame,
+    // and wait on the background when it was produced on the compute queue
+    vk_frame_data& frame = get_current_frame();
+    frame.timeline_value = graphics_timeline.advance();
+
+    std::array<VkSemaphoreSubmitInfo, 3> wait_infos;
+    std::array<VkSemaphoreSubmitInfo, 2> signal_infos;
+    u32 wait_count = 0;
+    u32 signal_count = 0;
+
+    if(wait_semaphore != VK_NULL_HANDLE) {
+        wait_infos[wait_count++] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, wait_semaphore);
+    }
+
+    if(use_async_compute) {
+        wait_infos[wait_count++] = compute_timeline.submit_info(VK_PIPELINE_STAGE_2_COPY_BIT, frame.compute_timeline_value);
+    }
+
+    // The ownership acquires at the start of the frame have to wait for the streamer's release
+    if(stream_wait_value != 0) {
+        wait_infos[wait_count] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, streamer.get_timeline_semaphore());
+        wait_infos[wait_count++].value = stream_wait_value;
+
+        stream_wait_value = 0;
+    }
 
-    VkSemaphoreSubmitInfo signalSemaphoreSubmitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, get_current_frame().render_semaphore);
-    VkSemaphoreSubmitInfo waitSemaphoreSubmitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, get_current_frame().swapchain_semaphore);
+    if(signal_semaphore != VK_NULL_HANDLE) {
+        signal_infos[signal_count++] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, signal_semaphore);
+    }
+
+    signal_infos[signal_count++] = graphics_timeline.submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.timeline_value);
+
+    VkCommandBufferSubmitInfo cmd_submit_info = vkinit::command_buffer_submit_info(cmd);
 
-    VkSubmitInfo2 submit_info = vkinit::submit_info(&cmd_submit_info, &signalSemaphoreSubmitInfo, &waitSemaphoreSubmitInfo);
+    VkSubmitInfo2 submit_info = vkinit::submit_info(&cmd_submit_info, signal_infos.data(), wait_infos.data());
+    submit_info.waitSemaphoreInfoCount = wait_count;
+    submit_info.signalSemaphoreInfoCount = signal_count;
 
     // Submit command buffer to the queue and execute it.
-    // render_fence will now block until the graphic commands finish execution
-    VK_CHECK(vkQueueSubmit2(graphics_queue, 1, &submit_info, get_current_frame().render_fence));
+    VK_CHECK(vkQueueSubmit2(graphics_queue, 1, &submit_info, nullptr));
+}
+
+u32 vk_renderer::build_scene_graph(VkCommandBuffer cmd) {
+    if(!stream_acquires.empty()) {
+        record_stream_acquires(cmd);
+    }
 
-    // Prepare present
-    // This will put the image we just rendered to into the visible window.
-    // We want to wait on the render_semaphore for that, as its necessary that drawing commands have finished before the image is displayed to the user
-    VkPresentInfoKHR present_info = {};
-    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.pNext = nullptr;
-    present_info.pSwapchains = &swapchain;
-    present_info.swapchainCount = 1;
+    // Every pipeline shares the bindless layout, so one bind per bind point covers the whole frame
+    bindless_heap.bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+    bindless_heap.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
 
-    present_info.pWaitSemaphores = &get_current_frame().render_semaphore;
-    present_info.waitSemaphoreCount = 1;
+    // Test mesh until there is a real scene to draw
+    draw_mesh(rectangle, glm::mat4{ 1.f }, config.virtual_texture_path.empty() ? DEFAULT_MATERIAL : virtual_texture_material);
 
-    present_info.pImageIndices = &swapchain_image_index;
+    prepare_render_queue();
 
-    VK_CHECK(vkQueuePresentKHR(graphics_queue, &present_info));
+    render_graph.reset();
 
-    frame_number++;
+    // Both get fully overwritten every frame
+    u32 draw = render_graph.import_image("draw_image", { draw_image.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+
+    // Depth only lives from the first geometry pass to the last one, later passes can reuse its memory.
+    // The depth pyramid samples it through the bindless heap
+    vk_transient_image_desc depth_desc{};
+    depth_desc.format = depth_format;
+    depth_desc.extent = draw_image.image_extent;
+    depth_desc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    depth_desc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    depth_desc.sampled_layout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+
+    u32 depth = render_graph.create_image("depth_image", depth_desc);
+
+    // The indirect draws of the gpu scene, written by the culling passes
+    u32 scene_draws = render_graph.create_token("scene_draws");
+
+    if(use_async_compute) {
+        // The background was already rendered on the compute queue, we only need to copy it over.
+        // The submit waits for it at the copy stage, in the layout the compute queue left it in
+        u32 background = render_graph.import_image("background_image", { get_current_frame().background_image.image, VK_IMAGE_ASPECT_COLOR_BIT,
+                                                                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT });
+
+        add_graph_pass("background_copy", [this](VkCommandBuffer cmd) {
+            vkutil::copy_image(cmd, get_current_frame().background_image.image, draw_image.image, draw_extent);
+        }).use(background, GRAPH_USAGE_TRANSFER_SRC).use(draw, GRAPH_USAGE_TRANSFER_DST);
+    } else {
+        add_graph_pass("background", [this](VkCommandBuffer cmd) {
+            draw_background(cmd, draw_image_index);
+        }).use(draw, GRAPH_USAGE_COMPUTE_WRITE);
+    }
+
+    // Compact the visible objects into this frame's indirect draws, draw_geometry then draws them in one call.
+    // With occlusion culling that is only what was visible last frame, the rest gets tested against its depth further down
+    bool scene_ready = is_gpu_scene_ready();
+    bool occlusion_culling = is_occlusion_culling_ready();
+    vk_gpu_cull_phase scene_phase = occlusion_culling ? GPU_CULL_PHASE_EARLY : GPU_CULL_PHASE_FRUSTUM_ONLY;
+
+    vk_gpu_cull_occlusion occlusion{ depth_pyramid.get_sampled_index(), depth_pyramid.get_sampler_index(), depth_pyramid.get_extent(), depth_pyramid.get_level_count() };
+    u32 frame_index = frame_number % frames.size();
+
+    if(scene_ready) {
+        add_graph_pass("cull", [this, frame_index, scene_phase, occlusion](VkCommandBuffer cmd) {
+            gpu_scene.record_cull(cmd, frame_index, scene_phase, cull_pipeline, bindless_heap.get_pipeline_layout(), view_projection, occlusion);
+        }).use(scene_draws, GRAPH_USAGE_COMPUTE_WRITE);
+    }
+
+    vk_graph_pass& geometry = add_graph_pass("geometry", [this, scene_phase, depth](VkCommandBuffer cmd) {
+        depth_image = render_graph.get_image(depth);
+        draw_geometry(cmd, scene_phase);
+    }).use(draw, GRAPH_USAGE_COLOR_ATTACHMENT).use(depth, GRAPH_USAGE_DEPTH_ATTACHMENT);
+
+    if(scene_ready) {
+        geometry.use(scene_draws, GRAPH_USAGE_INDIRECT_READ);
+    }
+
+    if(occlusion_culling) {
+        u32 pyramid = render_graph.import_image("depth_pyramid", { depth_pyramid.get_image(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+
+        add_graph_pass("depth_pyramid", [this](VkCommandBuffer cmd) {
+            depth_pyramid.record_build(cmd, depth_pyramid_pipeline, bindless_heap.get_pipeline_layout(), depth_image.sampled_index, draw_extent);
+        }).use(depth, GRAPH_USAGE_DEPTH_SAMPLED).use(pyramid, GRAPH_USAGE_COMPUTE_WRITE);
+
+        add_graph_pass("cull_late", [this, frame_index, occlusion](VkCommandBuffer cmd) {
+            gpu_scene.record_cull(cmd, frame_index, GPU_CULL_PHASE_LATE, cull_pipeline, bindless_heap.get_pipeline_layout(), view_projection, occlusion);
+        }).use(pyramid, GRAPH_USAGE_COMPUTE_READ).use(scene_draws, GRAPH_USAGE_COMPUTE_WRITE);
+
+        add_graph_pass("geometry_late", [this](VkCommandBuffer cmd) {
+            draw_geometry_late(cmd);
+        }).use(scene_draws, GRAPH_USAGE_INDIRECT_READ).use(draw, GRAPH_USAGE_COLOR_ATTACHMENT).use(depth, GRAPH_USAGE_DEPTH_ATTACHMENT);
+    }
+
+    // The enabled post effects work on the draw image in place, in manifest order. Each one is a pass of its own,
+    // so the graph places the barriers between them and keeps depth alive for the ones that read it
+    for(u32 index : effects.get_stage(EFFECT_STAGE_POST)) {
+        const vk_compute_effect& effect = effects.get_effect(index);
+        if(!effect.enabled || effect.pipeline == VK_NULL_HANDLE) continue;
+
+        vk_graph_pass& pass = add_graph_pass(effect.name.c_str(), [this, index, depth](VkCommandBuffer cmd) {
+            u32 depth_index = effects.get_effect(index).reads_depth ? render_graph.get_image(depth).sampled_index : 0;
+            effects.record(cmd, bindless_heap.get_pipeline_layout(), index, { draw_image_index, draw_extent, depth_index, effect_sampler_index, (u32)frame_number });
+        }).use(draw, GRAPH_USAGE_COMPUTE_WRITE);
+
+        if(effect.reads_depth) {
+            pass.use(depth, GRAPH_USAGE_DEPTH_SAMPLED);
+        }
+    }
+
+    return draw;
+}
+
+vk_graph_pass& vk_renderer::add_graph_pass(const char* name, std::function<void(VkCommandBuffer)>&& record) {
+    // Every pass gets a gpu timer under its own name, the barriers in front of it stay outside
+    return render_graph.add_pass(name, [this, name, record = std::move(record)](VkCommandBuffer cmd) {
+        profiler.begin_gpu_scope(cmd, get_current_frame().queries, name);
+        record(cmd);
+        profiler.end_gpu_scope(cmd, get_current_frame().queries);
+    });
 }
 
 void vk_renderer::init_vulkan() {
@@ -195,6 +628,8 @@ void vk_renderer::init_vulkan() {
             // .add_validation_feature_enable(VK)
             .require_api_version(1, 3, 0)
             .use_default_debug_messenger()
+            // Headless instances don't enable any surface extensions
+            .set_headless(is_headless())
             .build();
 
     vkb::Instance vkb_inst = inst_ret.value();
@@ -203,7 +638,8 @@ void vk_renderer::init_vulkan() {
     debug_messenger = vkb_inst.debug_messenger;
 
     // Create the surface
-    if(glfwCreateWindowSurface(instance, (GLFWwindow*)window_ptr, nullptr, &surface) != VK_SUCCESS) {
+    surface = VK_NULL_HANDLE;
+    if(!is_headless() && glfwCreateWindowSurface(instance, (GLFWwindow*)window_ptr, nullptr, &surface) != VK_SUCCESS) {
         LOG_THROW("Failed to create the window surface!");
     }
 
@@ -218,17 +654,49 @@ void vk_renderer::init_vulkan() {
     VkPhysicalDeviceVulkan12Features vk12_features = {};
     vk12_features.bufferDeviceAddress = true;
     vk12_features.descriptorIndexing = true;
+    vk12_features.timelineSemaphore = true;
+
+    // The gpu scene's draw count is written by the culling pass
+    vk12_features.drawIndirectCount = true;
+
+    // Bindless heap, large partially bound arrays that can be written while they are bound
+    vk12_features.runtimeDescriptorArray = true;
+    vk12_features.descriptorBindingPartiallyBound = true;
+    vk12_features.descriptorBindingSampledImageUpdateAfterBind = true;
+    vk12_features.descriptorBindingStorageImageUpdateAfterBind = true;
+    vk12_features.descriptorBindingUpdateUnusedWhilePending = true;
+    vk12_features.shaderSampledImageArrayNonUniformIndexing = true;
+
+    // Shaders index the bindless arrays with values from push constants and buffers
+    VkPhysicalDeviceFeatures features = {};
+    features.shaderSampledImageArrayDynamicIndexing = true;
+    features.shaderStorageImageArrayDynamicIndexing = true;
+    // Fragment shaders sampling virtual textures write the pages they want into the feedback buffer
+    features.fragmentStoresAndAtomics = true;
 
     // Use vkbootstrap to select a gpu.
     // We want a gpu that can write to the surface and supports vulkan 1.3 with the correct features
     vkb::PhysicalDeviceSelector selector{vkb_inst};
-    vkb::PhysicalDevice physical_device = selector
-            .set_minimum_version(1, 3)
-            .set_surface(surface)
+    selector.set_minimum_version(1, 3)
+            .set_required_features(features)
             .set_required_features_13(vk13_features)
-            .set_required_features_12(vk12_features)
-            .select()
-            .value();
+            .set_required_features_12(vk12_features);
+
+    // Without a surface vkbootstrap won't check for present support
+    if(!is_headless()) {
+        selector.set_surface(surface);
+    }
+
+    vkb::PhysicalDevice physical_device = selector.select().value();
+
+    // Lets VMA read the real budget of every heap instead of guessing it from the heap size
+    bool memory_budget_extension = physical_device.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // Textures are shipped block compressed, but gpus without BC can still run everything else.
+    // The texture manager checks every format before creating a texture with it
+    VkPhysicalDeviceFeatures optional_features = {};
+    optional_features.textureCompressionBC = true;
+    physical_device.enable_features_if_present(optional_features);
 
     vkb::DeviceBuilder device_builder{physical_device};
     vkb::Device vkb_device = device_builder.build().value();
@@ -249,28 +717,91 @@ void vk_renderer::init_vulkan() {
     graphics_queue = vkb_device.get_queue(vkb::QueueType::graphics).value();
     graphics_queue_family = vkb_device.get_queue_index(vkb::QueueType::graphics).value();
 
+    // Get a compute queue from a family without graphics support, sharing the graphics queue would gain nothing
+    if(config.async_compute) {
+        auto compute_queue_ret = vkb_device.get_dedicated_queue(vkb::QueueType::compute);
+
+        if(compute_queue_ret.has_value()) {
+            use_async_compute = true;
+            compute_queue = compute_queue_ret.value();
+            compute_queue_family = vkb_device.get_dedicated_queue_index(vkb::QueueType::compute).value();
+
+            LOG_INFO("- Using dedicated compute queue for background effects");
+        } else {
+            LOG_INFO("- No dedicated compute queue, background effects run on the graphics queue");
+        }
+    }
+
+    // Streaming needs a queue no other thread submits to, so a family shared with graphics or async compute won't do
+    if(config.transfer_streaming) {
+        auto transfer_queue_ret = vkb_device.get_dedicated_queue(vkb::QueueType::transfer);
+        auto transfer_family_ret = vkb_device.get_dedicated_queue_index(vkb::QueueType::transfer);
+
+        if(!transfer_queue_ret.has_value()) {
+            transfer_queue_ret = vkb_device.get_queue(vkb::QueueType::transfer);
+            transfer_family_ret = vkb_device.get_queue_index(vkb::QueueType::transfer);
+        }
+
+        if(transfer_queue_ret.has_value() && (!use_async_compute || transfer_family_ret.value() != compute_queue_family)) {
+            use_streaming = true;
+            transfer_queue = transfer_queue_ret.value();
+            transfer_queue_family = transfer_family_ret.value();
+
+            LOG_INFO("- Using transfer queue family " << transfer_queue_family << " for streaming");
+        } else {
+            LOG_INFO("- No separate transfer queue, streamed uploads go through the graphics queue");
+        }
+    }
+
+    // Timestamps are written on the graphics queue
+    profiler.init(chosen_gpu, graphics_queue_family);
+
     // Initialize the allocator
     VmaAllocatorCreateInfo allocator_info = {};
     allocator_info.physicalDevice = chosen_gpu;
     allocator_info.device = logical_device;
     allocator_info.instance = instance;
     allocator_info.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if(memory_budget_extension) {
+        allocator_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
     vmaCreateAllocator(&allocator_info, &allocator);
 
+    memory_budget.init(allocator, memory_budget_extension);
+
     main_deletion_queue.push_function([&]() {
         vmaDestroyAllocator(allocator);
     });
 }
 
 void vk_renderer::init_swapchain() {
-    auto width = 800;
-    auto height = 600;
+    u32 width = config.width;
+    u32 height = config.height;
 
-    create_swapchain(width, height);
+    if(is_headless()) {
+        // No swapchain to create, the draw image is the final target
+        swapchain_extent = {width, height};
+    } else {
+        int window_width, window_height;
+        glfwGetFramebufferSize((GLFWwindow*)window_ptr, &window_width, &window_height);
+
+        create_swapchain((u32)window_width, (u32)window_height, VK_NULL_HANDLE);
+
+        width = swapchain_extent.width;
+        height = swapchain_extent.height;
+    }
 
     // Draw image size will match the window size
-    VkExtent3D draw_img_extent = {width, height, 1};
+    create_draw_image({width, height, 1});
+
+    // Add to the deletion queue. The draw image gets reallocated when the window grows, so we destroy whichever one is current
+    main_deletion_queue.push_function([this]() {
+        vkDestroyImageView(logical_device, draw_image.image_view, nullptr);
+        vmaDestroyImage(allocator, draw_image.image, draw_image.allocation);
+    });
+}
 
+void vk_renderer::create_draw_image(VkExtent3D draw_img_extent) {
     // HARDCODING: draw format to 32bit float
     draw_image.image_format = VK_FORMAT_R16G16B16A16_SFLOAT;
     draw_image.image_extent = draw_img_extent;
@@ -296,11 +827,8 @@ void vk_renderer::init_swapchain() {
 
     VK_CHECK(vkCreateImageView(logical_device, &view_info, nullptr, &draw_image.image_view));
 
-    // Add to the deletion queue
-    main_deletion_queue.push_function([=]() {
-        vkDestroyImageView(logical_device, draw_image.image_view, nullptr);
-        vmaDestroyImage(allocator, draw_image.image, draw_image.allocation);
-    });
+    // Every frame slot picks up the new image once it's idle
+    draw_image_generation++;
 }
 
 void vk_renderer::init_commands() {
@@ -308,6 +836,8 @@ void vk_renderer::init_commands() {
     // We also want the pool to allow for resetting of individual command buffers
     VkCommandPoolCreateInfo pool_info = vkinit::command_pool_create_info(graphics_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
+    frames.resize(std::max(config.frames_in_flight, 1u));
+
     for(auto& frame : frames) {
         VK_CHECK(vkCreateCommandPool(logical_device, &pool_info, nullptr, &frame.command_pool));
 
@@ -315,210 +845,205 @@ void vk_renderer::init_commands() {
         VkCommandBufferAllocateInfo cmd_buffer_info = vkinit::command_buffer_allocate_info(frame.command_pool, 1);
 
         VK_CHECK(vkAllocateCommandBuffers(logical_device, &cmd_buffer_info, &frame.command_buffer));
-    }
-
-    // Add immediate submit structures
-    VK_CHECK(vkCreateCommandPool(logical_device, &pool_info, nullptr, &imm_command_pool));
 
-    // Allocate the cmd buffer for immediate submits
-    VkCommandBufferAllocateInfo cmd_buffer_info = vkinit::command_buffer_allocate_info(imm_command_pool, 1);
+        // Timestamp queries for the passes recorded into this frame's command buffer
+        profiler.init_frame(logical_device, frame.queries);
+    }
 
-    VK_CHECK(vkAllocateCommandBuffers(logical_device, &cmd_buffer_info, &imm_command_buffer));
+    // The render loop records chunks too, so leave it its core
+    u32 record_workers = config.record_threads;
+    if(record_workers == 0) {
+        record_workers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
 
-    main_deletion_queue.push_function([=]() {
-        vkDestroyCommandPool(logical_device, imm_command_pool, nullptr);
-    });
+    parallel_recorder.init(logical_device, graphics_queue_family, (u32)frames.size(), record_workers);
 }
 
 void vk_renderer::init_sync_structures() {
     // Create synchronization structures
-    // One fence to control when the gpu has finished rendering the frame
-    // And two semaphores to synchronize rendering with swapchain operations
-    // We want the fence to start signalled so we can wait on it on the first frame
-    VkFenceCreateInfo fence_info = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
+    // One timeline semaphore counting the frames the gpu has finished rendering
+    // And two semaphores per frame to synchronize rendering with swapchain operations
+    // Frames start at timeline value 0, which the semaphore already has, so the first wait returns immediately
     VkSemaphoreCreateInfo semaphore_info = vkinit::semaphore_create_info(0);
 
+    graphics_timeline.init(logical_device);
+
+    // Uploads are batched and submitted on the graphics queue ahead of the frame that uses them
+    uploader.init(logical_device, allocator, graphics_queue, graphics_queue_family, config.staging_buffer_size);
+
+    if(use_streaming) {
+        streamer.init(logical_device, allocator, transfer_queue, transfer_queue_family, graphics_queue_family, config.staging_buffer_size);
+    }
+
     for(auto& frame : frames) {
-        VK_CHECK(vkCreateFence(logical_device, &fence_info, nullptr, &frame.render_fence));
+        frame.timeline_value = 0;
+
         VK_CHECK(vkCreateSemaphore(logical_device, &semaphore_info, nullptr, &frame.swapchain_semaphore));
         VK_CHECK(vkCreateSemaphore(logical_device, &semaphore_info, nullptr, &frame.render_semaphore));
     }
-
-    // Immediate submit structures
-    VK_CHECK(vkCreateFence(logical_device, &fence_info, nullptr, &imm_fence));
-    main_deletion_queue.push_function([=]() { vkDestroyFence(logical_device, imm_fence, nullptr); });
 }
 
-void vk_renderer::init_descriptors() {
-    // Create a descriptor pool that will hold 10 sets with 1 image each
-    std::vector<vk_descriptor_allocator::pool_size_ratio> pool_sizes = {
-            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
-    };
-
-    global_descriptor_allocator.init_pool(logical_device, 10, pool_sizes);
-
-    // Make the descriptor set layout for our compute draw
-    vk_descriptor_layout_builder builder;
-    builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-    draw_image_descriptor_layout = builder.build(logical_device, VK_SHADER_STAGE_COMPUTE_BIT);
+void vk_renderer::init_async_compute() {
+    VkCommandPoolCreateInfo pool_info = vkinit::command_pool_create_info(compute_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-    // Allocate a descriptor set for our draw image
-    draw_image_descriptors = global_descriptor_allocator.allocate(logical_device, draw_image_descriptor_layout);
+    compute_timeline.init(logical_device);
 
-    VkDescriptorImageInfo img_info{};
-    img_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    img_info.imageView = draw_image.image_view;
+    for(auto& frame : frames) {
+        VK_CHECK(vkCreateCommandPool(logical_device, &pool_info, nullptr, &frame.compute_command_pool));
 
-    VkWriteDescriptorSet draw_image_write{};
-    draw_image_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    draw_image_write.pNext = nullptr;
+        VkCommandBufferAllocateInfo cmd_buffer_info = vkinit::command_buffer_allocate_info(frame.compute_command_pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(logical_device, &cmd_buffer_info, &frame.compute_command_buffer));
 
-    draw_image_write.dstBinding = 0;
-    draw_image_write.dstSet = draw_image_descriptors;
-    draw_image_write.descriptorCount = 1;
-    draw_image_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    draw_image_write.pImageInfo = &img_info;
+        frame.compute_timeline_value = 0;
 
-    vkUpdateDescriptorSets(logical_device, 1, &draw_image_write, 0, nullptr);
+        // Every frame gets its own background so the compute queue can run ahead of the graphics queue
+        create_background_image(frame);
+    }
 
-    // Add to the deletion queue
-    main_deletion_queue.push_function([=]() {
-        vkDestroyDescriptorSetLayout(logical_device, draw_image_descriptor_layout, nullptr);
-        global_descriptor_allocator.destroy_pool(logical_device);
+    main_deletion_queue.push_function([this]() {
+        for(auto& frame : frames) {
+            destroy_background_image(frame);
+        }
     });
 }
 
-void vk_renderer::init_pipelines() {
-    init_background_pipelines();
-    init_triangle_pipeline();
-}
+void vk_renderer::create_background_image(vk_frame_data& frame) {
+    // Both queues touch the background images, concurrent sharing saves us the queue family ownership transfers
+    u32 queue_families[] = {graphics_queue_family, compute_queue_family};
 
-void vk_renderer::init_background_pipelines() {
-    VkPipelineLayoutCreateInfo compute_layout{};
-    compute_layout.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    compute_layout.pNext = nullptr;
-    compute_layout.setLayoutCount = 1;
-    compute_layout.pSetLayouts = &draw_image_descriptor_layout;
+    VkImageCreateInfo img_info = vkinit::image_create_info(draw_image.image_format, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, draw_image.image_extent);
+    img_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    img_info.queueFamilyIndexCount = (u32)std::size(queue_families);
+    img_info.pQueueFamilyIndices = queue_families;
 
-    VkPushConstantRange push_constant{};
-    push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    push_constant.offset = 0;
-    push_constant.size = sizeof(vk_compute_push_constants);
+    VmaAllocationCreateInfo img_alloc_info = {};
+    img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    img_alloc_info.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    compute_layout.pPushConstantRanges = &push_constant;
-    compute_layout.pushConstantRangeCount = 1;
+    vk_allocated_image& image = frame.background_image;
+    image.image_format = draw_image.image_format;
+    image.image_extent = draw_image.image_extent;
 
-    VK_CHECK(vkCreatePipelineLayout(logical_device, &compute_layout, nullptr, &gradient_pipeline_layout));
+    VK_CHECK(vmaCreateImage(allocator, &img_info, &img_alloc_info, &image.image, &image.allocation, nullptr));
 
-    VkShaderModule gradient_shader;
-    if (!vkutil::load_shader_module("../shaders/gradient_color.comp.spv", logical_device, &gradient_shader)) {
-        // Print the working directory
-        char cwd[1024];
-        getcwd(cwd, sizeof(cwd));
-        LOG_INFO("Working directory: %s", cwd);
+    VkImageViewCreateInfo view_info = vkinit::imageview_create_info(image.image_format, image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(logical_device, &view_info, nullptr, &image.image_view));
+}
 
-        LOG_THROW("Failed to load compute shader");
-    }
+void vk_renderer::destroy_background_image(vk_frame_data& frame) {
+    vkDestroyImageView(logical_device, frame.background_image.image_view, nullptr);
+    vmaDestroyImage(allocator, frame.background_image.image, frame.background_image.allocation);
+}
 
-    VkShaderModule sky_shader;
-    if (!vkutil::load_shader_module("../shaders/sky.comp.spv", logical_device, &sky_shader)) {
-        // Print the working directory
-        char cwd[1024];
-        getcwd(cwd, sizeof(cwd));
-        LOG_INFO("Working directory: %s", cwd);
+void vk_renderer::init_descriptors() {
+    // Every image and sampler lives in the bindless heap, shaders get their indices through push constants
+    bindless_heap.init(logical_device, chosen_gpu, config.bindless_sampled_images, config.bindless_storage_images, config.bindless_samplers);
 
-        LOG_THROW("Failed to load compute shader");
-    }
+    draw_image_index = bindless_heap.add_storage_image(draw_image.image_view);
 
-    VkPipelineShaderStageCreateInfo stage_info{};
-    stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    stage_info.pNext = nullptr;
-    stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    stage_info.module = gradient_shader;
-    stage_info.pName = "main";
+    // Transient attachments get their sampled views registered in the heap as they are allocated
+    render_graph.init(logical_device, allocator, &bindless_heap, [this](std::function<void()>&& function) {
+        retire(std::move(function));
+    });
 
-    VkComputePipelineCreateInfo compute_pipeline_create_info{};
-    compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    compute_pipeline_create_info.pNext = nullptr;
-    compute_pipeline_create_info.layout = gradient_pipeline_layout;
-    compute_pipeline_create_info.stage = stage_info;
+    // Per frame pools for transient sets, they grow on demand and get reset in bulk
+    std::array<vk_descriptor_allocator::pool_size_ratio, 5> frame_sizes = {{
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
+            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 3 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+    }};
 
+    for(auto& frame : frames) {
+        frame.frame_descriptors.init(logical_device, 1000, frame_sizes);
 
-    // Create the gradient compute effect
-    vk_compute_effect gradient{};
-    gradient.layout = gradient_pipeline_layout;
-    gradient.name = "gradient";
-    gradient.data = {};
+        if(use_async_compute) {
+            frame.background_image_index = bindless_heap.add_storage_image(frame.background_image.image_view);
+        }
 
-    // default colors
-    gradient.data.data1 = glm::vec4(1, 0, 0, 1);
-    gradient.data.data2 = glm::vec4(0, 0, 1, 1);
+        frame.draw_image_generation = draw_image_generation;
+    }
 
-    VK_CHECK(vkCreateComputePipelines(logical_device, nullptr, 1, &compute_pipeline_create_info, nullptr,
-                                      &gradient.pipeline));
+    // Add to the deletion queue
+    main_deletion_queue.push_function([=, this]() {
+        for(auto& frame : frames) {
+            frame.frame_descriptors.destroy_pools(logical_device);
+        }
 
-    // Create the Sky
+        render_graph.destroy();
+        bindless_heap.destroy();
+    });
+}
 
-    // Change the shader module to create the sky shader
-    compute_pipeline_create_info.stage.module = sky_shader;
+void vk_renderer::init_pipelines() {
+    auto start = std::chrono::high_resolution_clock::now();
 
-    vk_compute_effect sky{};
-    sky.layout = gradient_pipeline_layout;
-    sky.name = "sky";
-    sky.data = {};
+    pipeline_cache.init(logical_device, chosen_gpu, config.pipeline_cache_path);
 
-    // Default sky params
-    sky.data.data1 = glm::vec4(0.1, 0.2, 0.4, 0.97);
+    // Leave one core for the render loop
+    u32 worker_count = config.pipeline_compile_threads;
+    if(worker_count == 0) {
+        worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
 
-    VK_CHECK(vkCreateComputePipelines(logical_device, nullptr, 1, &compute_pipeline_create_info, nullptr,
-                                      &sky.pipeline));
+    shader_registry.init(logical_device);
 
-    // Add background effects to the list
-    background_effects.push_back(gradient);
-    background_effects.push_back(sky);
+    if(config.hot_reload_shaders) {
+        shader_watcher.init(config.shader_directory);
+    }
+    pipeline_compiler.init(logical_device, &shader_registry, &pipeline_cache, worker_count);
 
-    vkDestroyShaderModule(logical_device, gradient_shader, nullptr);
-    vkDestroyShaderModule(logical_device, sky_shader, nullptr);
+    init_effect_pipelines();
+    init_triangle_pipeline();
+    init_mesh_pipeline();
+    init_virtual_texture_pipeline();
+    init_gpu_scene_pipelines();
 
-    main_deletion_queue.push_function([&]() {
-        vkDestroyPipelineLayout(logical_device, gradient_pipeline_layout, nullptr);
+    auto end = std::chrono::high_resolution_clock::now();
 
-        for (const auto &bg_effect: background_effects) {
-            vkDestroyPipeline(logical_device, bg_effect.pipeline, nullptr);
-        }
-    });
+    LOG_INFO("Fallback pipelines ready in " << std::chrono::duration<f64, std::milli>(end - start).count() << "ms, "
+             << pending_pipelines.size() << " pipelines still compiling on " << pipeline_compiler.get_worker_count() << " workers");
 }
 
-void vk_renderer::init_triangle_pipeline() {
-    VkShaderModule triangle_vert_shader;
-    if(!vkutil::load_shader_module("../shaders/colored_triangle.vert.spv", logical_device, &triangle_vert_shader)) {
-        // Print the working directory
-        char cwd[1024];
-        getcwd(cwd, sizeof(cwd));
-        LOG_INFO("Working directory: %s", cwd);
+void vk_renderer::init_effect_pipelines() {
+    // The effects write into the storage image array of the bindless heap, the target index is part of the push constants
+    effects.load(get_shader_path(config.effect_manifest.c_str()), config.shader_directory);
 
-        LOG_THROW("Failed to load vertex shader");
-    }
+    // The first background effect is the fallback for the others, we can't render a frame without it.
+    // It goes to the workers first and the rest right behind it, so they all compile in one batch
+    u32 fallback = effects.get_stage(EFFECT_STAGE_BACKGROUND)[0];
+    queue_effect(fallback, false);
 
-    VkShaderModule triangle_frag_shader;
-    if(!vkutil::load_shader_module("../shaders/colored_triangle.frag.spv", logical_device, &triangle_frag_shader)) {
-        // Print the working directory
-        char cwd[1024];
-        getcwd(cwd, sizeof(cwd));
-        LOG_INFO("Working directory: %s", cwd);
+    for(u32 i = 0; i < effects.get_effect_count(); i++) {
+        if(i != fallback) {
+            queue_effect(i, false);
+        }
 
-        LOG_THROW("Failed to load fragment shader");
+        reloadable_pipelines.push_back({ { effects.get_effect(i).shader_path }, [this, i]() { queue_effect(i, true); } });
     }
 
+    pending_pipelines.front().install(pending_pipelines.front().future.get());
+    pending_pipelines.erase(pending_pipelines.begin());
+
+    main_deletion_queue.push_function([&]() {
+        effects.destroy(logical_device);
+    });
+}
+
+void vk_renderer::init_triangle_pipeline() {
     // Build the pipeline layout that controls the inputs/outputs of the shader
     // We are not using descriptor sets or other fancy stuff yet, so this can be empty for now
     VkPipelineLayoutCreateInfo pipeline_layout_info = vkinit::pipeline_layout_create_info();
     VK_CHECK(vkCreatePipelineLayout(logical_device, &pipeline_layout_info, nullptr, &triangle_pipeline_layout));
 
-    vk_pipeline_builder pipeline_builder;
+    vk_graphics_pipeline_desc& desc = triangle_pipeline_desc;
+    desc.vert_shader_path = get_shader_path("colored_triangle.vert.spv");
+    desc.frag_shader_path = get_shader_path("colored_triangle.frag.spv");
+
+    vk_pipeline_builder& pipeline_builder = desc.builder;
 
     pipeline_builder.pipeline_layout = triangle_pipeline_layout;
-    pipeline_builder.set_shaders(triangle_vert_shader, triangle_frag_shader);
     pipeline_builder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
     pipeline_builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
     pipeline_builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
@@ -526,16 +1051,15 @@ void vk_renderer::init_triangle_pipeline() {
     pipeline_builder.disable_blending();
     pipeline_builder.disable_depthtest();
 
-    // Connect the image format we will draw into
+    // Connect the image format we will draw into. The triangle doesn't use depth, but it is drawn in the same pass as the meshes
     pipeline_builder.set_color_attachment_format(draw_image.image_format);
-    pipeline_builder.set_depth_format(VK_FORMAT_UNDEFINED);
+    pipeline_builder.set_depth_format(depth_format);
 
-    // Finally build the pipeline
-    triangle_pipeline = pipeline_builder.build_pipeline(logical_device);
+    // Finally build the pipeline. Until it is done, draw_geometry skips the triangle
+    triangle_pipeline = VK_NULL_HANDLE;
+    queue_triangle_pipeline(false);
 
-    // Cleanup
-    vkDestroyShaderModule(logical_device, triangle_vert_shader, nullptr);
-    vkDestroyShaderModule(logical_device, triangle_frag_shader, nullptr);
+    reloadable_pipelines.push_back({ { desc.vert_shader_path, desc.frag_shader_path }, [this]() { queue_triangle_pipeline(true); } });
 
     main_deletion_queue.push_function([&]() {
         vkDestroyPipelineLayout(logical_device, triangle_pipeline_layout, nullptr);
@@ -543,6 +1067,332 @@ void vk_renderer::init_triangle_pipeline() {
     });
 }
 
+void vk_renderer::init_mesh_pipeline() {
+    // The vertex buffer address and the world matrix are passed through the push constants of the bindless layout
+    static_assert(sizeof(vk_gpu_draw_push_constants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+
+    vk_graphics_pipeline_desc& desc = mesh_pipeline_desc;
+    desc.vert_shader_path = get_shader_path("colored_triangle_mesh.vert.spv");
+    desc.frag_shader_path = get_shader_path("colored_triangle.frag.spv");
+
+    vk_pipeline_builder& pipeline_builder = desc.builder;
+
+    // Vertices are pulled from the vertex buffer in the shader, the builder's empty vertex input state stays as is
+    pipeline_builder.pipeline_layout = bindless_heap.get_pipeline_layout();
+    pipeline_builder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline_builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipeline_builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+    pipeline_builder.set_multisampling_none();
+    pipeline_builder.disable_blending();
+    pipeline_builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+    pipeline_builder.set_color_attachment_format(draw_image.image_format);
+    pipeline_builder.set_depth_format(depth_format);
+
+    // Until it is done, draw_geometry skips the meshes
+    mesh_pipeline = VK_NULL_HANDLE;
+    queue_mesh_pipeline(false);
+
+    // The default material draws with it
+    render_pipelines.push_back(&mesh_pipeline);
+    materials.push_back({ 0 });
+
+    reloadable_pipelines.push_back({ { desc.vert_shader_path, desc.frag_shader_path }, [this]() { queue_mesh_pipeline(true); } });
+
+    main_deletion_queue.push_function([&]() {
+        vkDestroyPipeline(logical_device, mesh_pipeline, nullptr);
+    });
+}
+
+void vk_renderer::init_virtual_texture_pipeline() {
+    // Only the test quad samples a virtual texture, without one the pipeline isn't needed
+    if(config.virtual_texture_path.empty()) return;
+
+    vk_graphics_pipeline_desc& desc = virtual_texture_pipeline_desc;
+    desc.vert_shader_path = get_shader_path("colored_triangle_mesh.vert.spv");
+    desc.frag_shader_path = get_shader_path("virtual_texture_mesh.frag.spv");
+
+    vk_pipeline_builder& pipeline_builder = desc.builder;
+
+    pipeline_builder.pipeline_layout = bindless_heap.get_pipeline_layout();
+    pipeline_builder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline_builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipeline_builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+    pipeline_builder.set_multisampling_none();
+    pipeline_builder.disable_blending();
+    pipeline_builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+    pipeline_builder.set_color_attachment_format(draw_image.image_format);
+    pipeline_builder.set_depth_format(depth_format);
+
+    // Draws of the material are skipped until it is done
+    virtual_texture_pipeline = VK_NULL_HANDLE;
+    queue_virtual_texture_pipeline(false);
+
+    render_pipelines.push_back(&virtual_texture_pipeline);
+    virtual_texture_material = (u32)materials.size();
+    materials.push_back({ (u32)render_pipelines.size() - 1 });
+
+    reloadable_pipelines.push_back({ { desc.vert_shader_path, desc.frag_shader_path }, [this]() { queue_virtual_texture_pipeline(true); } });
+
+    main_deletion_queue.push_function([&]() {
+        vkDestroyPipeline(logical_device, virtual_texture_pipeline, nullptr);
+    });
+}
+
+void vk_renderer::init_gpu_scene() {
+    gpu_scene.init(logical_device, allocator, &uploader, (u32)frames.size(), config.max_scene_objects, config.max_scene_vertices, config.max_scene_indices);
+
+    // Sized after the whole draw image, it gets recreated along with it
+    depth_pyramid.init(logical_device, allocator, &bindless_heap, {draw_image.image_extent.width, draw_image.image_extent.height});
+
+    main_deletion_queue.push_function([this]() {
+        depth_pyramid.destroy();
+        gpu_scene.destroy();
+    });
+}
+
+void vk_renderer::init_gpu_scene_pipelines() {
+    static_assert(sizeof(vk_gpu_cull_push_constants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+    static_assert(sizeof(vk_gpu_indirect_push_constants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+    static_assert(sizeof(vk_depth_pyramid_push_constants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+
+    cull_shader_path = get_shader_path("cull.comp.spv");
+    depth_pyramid_shader_path = get_shader_path("depth_pyramid.comp.spv");
+
+    vk_graphics_pipeline_desc& desc = indirect_mesh_pipeline_desc;
+    desc.vert_shader_path = get_shader_path("indirect_mesh.vert.spv");
+    desc.frag_shader_path = get_shader_path("colored_triangle.frag.spv");
+
+    vk_pipeline_builder& pipeline_builder = desc.builder;
+
+    pipeline_builder.pipeline_layout = bindless_heap.get_pipeline_layout();
+    pipeline_builder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline_builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipeline_builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+    pipeline_builder.set_multisampling_none();
+    pipeline_builder.disable_blending();
+    pipeline_builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+    pipeline_builder.set_color_attachment_format(draw_image.image_format);
+    pipeline_builder.set_depth_format(depth_format);
+
+    // The scene is skipped until both are done, and occlusion culling until the pyramid pipeline is done too
+    cull_pipeline = VK_NULL_HANDLE;
+    indirect_mesh_pipeline = VK_NULL_HANDLE;
+    depth_pyramid_pipeline = VK_NULL_HANDLE;
+    queue_cull_pipeline(false);
+    queue_indirect_mesh_pipeline(false);
+    queue_depth_pyramid_pipeline(false);
+
+    reloadable_pipelines.push_back({ { cull_shader_path }, [this]() { queue_cull_pipeline(true); } });
+    reloadable_pipelines.push_back({ { depth_pyramid_shader_path }, [this]() { queue_depth_pyramid_pipeline(true); } });
+    reloadable_pipelines.push_back({ { desc.vert_shader_path, desc.frag_shader_path }, [this]() { queue_indirect_mesh_pipeline(true); } });
+
+    main_deletion_queue.push_function([&]() {
+        vkDestroyPipeline(logical_device, cull_pipeline, nullptr);
+        vkDestroyPipeline(logical_device, indirect_mesh_pipeline, nullptr);
+        vkDestroyPipeline(logical_device, depth_pyramid_pipeline, nullptr);
+    });
+}
+
+void vk_renderer::init_default_data() {
+    std::array<vk_vertex, 4> rect_vertices{};
+
+    rect_vertices[0].position = {0.5, -0.5, 0};
+    rect_vertices[1].position = {0.5, 0.5, 0};
+    rect_vertices[2].position = {-0.5, -0.5, 0};
+    rect_vertices[3].position = {-0.5, 0.5, 0};
+
+    rect_vertices[0].color = {0, 0, 0, 1};
+    rect_vertices[1].color = {0.5, 0.5, 0.5, 1};
+    rect_vertices[2].color = {1, 0, 0, 1};
+    rect_vertices[3].color = {0, 1, 0, 1};
+
+    std::array<u32, 6> rect_indices = {0, 1, 2, 2, 1, 3};
+
+    rectangle = upload_mesh(rect_indices, rect_vertices);
+
+    // Textures upload through the same staging ring as meshes and live in the bindless heap
+    texture_manager.init(logical_device, chosen_gpu, allocator, &uploader, &bindless_heap);
+
+    // Effects get one sampler for whatever they sample, the images they read are the size of the draw extent
+    effect_sampler_index = texture_manager.get_sampler({ VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE });
+
+    vk_virtual_texture_cache_desc virtual_texture_desc{};
+    virtual_texture_desc.page_size = config.virtual_texture_page_size;
+    virtual_texture_desc.pages_per_side = config.virtual_texture_cache_pages;
+    virtual_texture_desc.max_uploads_per_frame = config.virtual_texture_uploads_per_frame;
+    virtual_texture_cache.init(logical_device, allocator, &uploader, &bindless_heap, (u32)frames.size(), virtual_texture_desc);
+
+    main_deletion_queue.push_function([this]() {
+        virtual_texture_cache.destroy();
+        texture_manager.destroy();
+    });
+
+    if(!config.virtual_texture_path.empty()) {
+        test_virtual_texture = virtual_texture_cache.load(config.virtual_texture_path);
+    }
+
+    // A square grid of small quads reaching a bit past the screen edges, so the culling has something to throw away
+    if(config.test_scene_objects > 0) {
+        vk_gpu_scene_mesh quad = gpu_scene.add_mesh(rect_indices, rect_vertices);
+
+        u32 grid_size = (u32)std::ceil(std::sqrt((f64)config.test_scene_objects));
+        f32 spacing = 2.4f / grid_size;
+
+        for(u32 i = 0; i < config.test_scene_objects; i++) {
+            glm::vec3 position = { -1.2f + spacing * (i % grid_size + 0.5f), -1.2f + spacing * (i / grid_size + 0.5f), 0.5f };
+
+            glm::mat4 world = glm::translate(glm::mat4{ 1.f }, position);
+            world = glm::scale(world, glm::vec3(spacing * 0.8f));
+
+            gpu_scene.add_object(quad, world);
+        }
+    }
+
+    main_deletion_queue.push_function([&]() {
+        destroy_buffer(rectangle.index_buffer);
+        destroy_buffer(rectangle.vertex_buffer);
+    });
+
+    // Room for some instances per frame to start with, the buffers grow with the render queue
+    for(auto& frame : frames) {
+        frame.instance_buffer = {};
+        frame.instance_capacity = 0;
+        grow_instance_buffer(frame, 1024);
+    }
+
+    main_deletion_queue.push_function([this]() {
+        for(auto& frame : frames) {
+            destroy_buffer(frame.instance_buffer);
+        }
+    });
+}
+
+void vk_renderer::queue_effect(u32 index, bool is_reload) {
+    const vk_compute_effect& effect = effects.get_effect(index);
+
+    // The shaders take their local size from constants 0 and 1, so it always matches the dispatch in vk_effect_registry::record
+    vk_compute_pipeline_desc desc{ .shader_path = effect.shader_path, .layout = bindless_heap.get_pipeline_layout(),
+                                   .specialization = { effect.workgroup_size.width, effect.workgroup_size.height } };
+
+    queue_pipeline(pipeline_compiler.compile(desc), [this, index](VkPipeline pipeline) {
+        swap_pipeline(effects.get_effect(index).pipeline, pipeline);
+    }, is_reload);
+}
+
+void vk_renderer::queue_triangle_pipeline(bool is_reload) {
+    queue_pipeline(pipeline_compiler.compile(triangle_pipeline_desc), [this](VkPipeline pipeline) {
+        swap_pipeline(triangle_pipeline, pipeline);
+    }, is_reload);
+}
+
+void vk_renderer::queue_mesh_pipeline(bool is_reload) {
+    queue_pipeline(pipeline_compiler.compile(mesh_pipeline_desc), [this](VkPipeline pipeline) {
+        swap_pipeline(mesh_pipeline, pipeline);
+    }, is_reload);
+}
+
+void vk_renderer::queue_virtual_texture_pipeline(bool is_reload) {
+    queue_pipeline(pipeline_compiler.compile(virtual_texture_pipeline_desc), [this](VkPipeline pipeline) {
+        swap_pipeline(virtual_texture_pipeline, pipeline);
+    }, is_reload);
+}
+
+void vk_renderer::queue_cull_pipeline(bool is_reload) {
+    vk_compute_pipeline_desc desc{ .shader_path = cull_shader_path, .layout = bindless_heap.get_pipeline_layout() };
+
+    queue_pipeline(pipeline_compiler.compile(desc), [this](VkPipeline pipeline) {
+        swap_pipeline(cull_pipeline, pipeline);
+    }, is_reload);
+}
+
+void vk_renderer::queue_depth_pyramid_pipeline(bool is_reload) {
+    vk_compute_pipeline_desc desc{ .shader_path = depth_pyramid_shader_path, .layout = bindless_heap.get_pipeline_layout() };
+
+    queue_pipeline(pipeline_compiler.compile(desc), [this](VkPipeline pipeline) {
+        swap_pipeline(depth_pyramid_pipeline, pipeline);
+    }, is_reload);
+}
+
+void vk_renderer::queue_indirect_mesh_pipeline(bool is_reload) {
+    queue_pipeline(pipeline_compiler.compile(indirect_mesh_pipeline_desc), [this](VkPipeline pipeline) {
+        swap_pipeline(indirect_mesh_pipeline, pipeline);
+    }, is_reload);
+}
+
+void vk_renderer::queue_pipeline(std::future<VkPipeline>&& future, std::function<void(VkPipeline)>&& install, bool is_reload) {
+    pending_pipelines.push_back({ std::move(future), std::move(install), is_reload });
+}
+
+void vk_renderer::install_ready_pipelines(bool wait) {
+    for(auto it = pending_pipelines.begin(); it != pending_pipelines.end();) {
+        if(!wait && it->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            it++;
+            continue;
+        }
+
+        // Rethrows if the build failed on the worker. A broken shader saved while iterating keeps the old pipeline instead
+        VkPipeline pipeline;
+        try {
+            pipeline = it->future.get();
+        } catch(const std::exception& e) {
+            if(!it->is_reload) throw;
+
+            LOG_INFO("Hot reload: " << e.what() << ", keeping the old pipeline");
+            it = pending_pipelines.erase(it);
+            continue;
+        }
+
+        it->install(pipeline);
+        it = pending_pipelines.erase(it);
+    }
+
+    // Every build is done, the modules replaced by hot reloads can go
+    if(pending_pipelines.empty()) {
+        shader_registry.release_invalidated();
+    }
+}
+
+void vk_renderer::swap_pipeline(VkPipeline& target, VkPipeline pipeline) {
+    // Frames still in flight may use the old pipeline
+    if(target != VK_NULL_HANDLE) {
+        VkPipeline old_pipeline = target;
+        retire([=]() { vkDestroyPipeline(logical_device, old_pipeline, nullptr); });
+    }
+
+    target = pipeline;
+}
+
+void vk_renderer::reload_changed_shaders() {
+    std::vector<std::string> changed = shader_watcher.poll_changes();
+    if(changed.empty()) return;
+
+    for(const std::string& path : changed) {
+        // Make the next load read the file again instead of handing out the old module
+        shader_registry.invalidate(path);
+    }
+
+    for(auto& reloadable : reloadable_pipelines) {
+        bool affected = std::any_of(reloadable.shader_paths.begin(), reloadable.shader_paths.end(), [&](const std::string& shader_path) {
+            return std::find(changed.begin(), changed.end(), shader_registry.canonical_path(shader_path)) != changed.end();
+        });
+
+        if(affected) {
+            reloadable.rebuild();
+        }
+    }
+
+    for(const std::string& path : changed) {
+        LOG_INFO("Hot reload: " << path << " changed, rebuilding its pipelines");
+    }
+}
+
+std::string vk_renderer::get_shader_path(const char* file_name) const {
+    return config.shader_directory + "/" + file_name;
+}
+
 void vk_renderer::init_imgui() {
     // 1. Create Descriptor Pool for IMGUI
     // The size of the pool is very oversize, but it's copied from the imgui example itself
@@ -599,57 +1449,300 @@ void vk_renderer::init_imgui() {
     });
 }
 
-void vk_renderer::immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function) {
-    VK_CHECK(vkResetFences(logical_device, 1, &imm_fence));
-    VK_CHECK(vkResetCommandBuffer(imm_command_buffer, 0));
+vk_allocated_buffer vk_renderer::create_buffer(size_t alloc_size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage) {
+    VkBufferCreateInfo buffer_info = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.pNext = nullptr;
+    buffer_info.size = alloc_size;
+    buffer_info.usage = usage;
 
-    VkCommandBuffer cmd = imm_command_buffer;
+    // Mapped on creation when it is host visible, info.pMappedData then points at the memory
+    VmaAllocationCreateInfo vma_alloc_info = {};
+    vma_alloc_info.usage = memory_usage;
+    vma_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
-    VkCommandBufferBeginInfo cmdBeginInfo =
-            vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    vk_allocated_buffer new_buffer;
+    VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &vma_alloc_info, &new_buffer.buffer, &new_buffer.allocation, &new_buffer.info));
 
-    VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+    return new_buffer;
+}
+
+void vk_renderer::destroy_buffer(const vk_allocated_buffer& buffer) {
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+}
 
-    function(cmd);
+vk_gpu_mesh_buffers vk_renderer::upload_mesh(std::span<const u32> indices, std::span<const vk_vertex> vertices) {
+    const size_t vertex_buffer_size = vertices.size_bytes();
+    const size_t index_buffer_size = indices.size_bytes();
 
-    VK_CHECK(vkEndCommandBuffer(cmd));
+    vk_gpu_mesh_buffers new_surface;
+    new_surface.index_count = (u32)indices.size();
+    new_surface.mesh_id = mesh_count++;
 
-    VkCommandBufferSubmitInfo cmd_submit_info = vkinit::command_buffer_submit_info(cmd);
-    VkSubmitInfo2 submit_info = vkinit::submit_info(&cmd_submit_info, nullptr, nullptr);
+    // The vertex buffer is read through its device address in the vertex shader
+    new_surface.vertex_buffer = create_buffer(vertex_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                              VMA_MEMORY_USAGE_GPU_ONLY);
 
-    // Submit command buffer to the queue and execute it.
-    // render_fence will now block until the graphic commands finish execution
-    VK_CHECK(vkQueueSubmit2(graphics_queue, 1, &submit_info, imm_fence));
+    VkBufferDeviceAddressInfo device_address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = new_surface.vertex_buffer.buffer };
+    new_surface.vertex_buffer_address = vkGetBufferDeviceAddress(logical_device, &device_address_info);
+
+    new_surface.index_buffer = create_buffer(index_buffer_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    // Device local memory isn't host visible, so the data goes through the staging ring
+    uploader.upload_buffer(new_surface.vertex_buffer.buffer, 0, vertices.data(), vertex_buffer_size);
+    uploader.upload_buffer(new_surface.index_buffer.buffer, 0, indices.data(), index_buffer_size);
+
+    return new_surface;
+}
+
+u64 vk_renderer::stream_mesh(std::span<const u32> indices, std::span<const vk_vertex> vertices, vk_gpu_mesh_buffers& mesh) {
+    u64 request_id = ++stream_request_count;
+
+    // Without a transfer queue the mesh goes through the regular uploader, which runs ahead of the next frame anyway
+    if(!use_streaming) {
+        mesh = upload_mesh(indices, vertices);
+        completed_stream_id = request_id;
+
+        return request_id;
+    }
+
+    mesh.index_count = (u32)indices.size();
+    mesh.mesh_id = mesh_count++;
+    mesh.vertex_buffer = create_buffer(vertices.size_bytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                       VMA_MEMORY_USAGE_GPU_ONLY);
+    mesh.index_buffer = create_buffer(indices.size_bytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    VkBufferDeviceAddressInfo device_address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = mesh.vertex_buffer.buffer };
+    mesh.vertex_buffer_address = vkGetBufferDeviceAddress(logical_device, &device_address_info);
+
+    vk_stream_request request{};
+    request.id = request_id;
+
+    const u8* vertex_bytes = (const u8*)vertices.data();
+    const u8* index_bytes = (const u8*)indices.data();
+
+    request.buffers.push_back({ mesh.vertex_buffer.buffer, std::vector<u8>(vertex_bytes, vertex_bytes + vertices.size_bytes()) });
+    request.buffers.push_back({ mesh.index_buffer.buffer, std::vector<u8>(index_bytes, index_bytes + indices.size_bytes()) });
+
+    streamer.submit(std::move(request));
+
+    return request_id;
+}
+
+void vk_renderer::record_stream_acquires(VkCommandBuffer cmd) {
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+
+    for(vk_stream_completion& completion : stream_acquires) {
+        buffer_barriers.insert(buffer_barriers.end(), completion.buffer_acquires.begin(), completion.buffer_acquires.end());
+        image_barriers.insert(image_barriers.end(), completion.image_acquires.begin(), completion.image_acquires.end());
+
+        stream_wait_value = std::max(stream_wait_value, completion.value);
+        completed_stream_id = std::max(completed_stream_id, completion.id);
+    }
+
+    VkDependencyInfo dep_info = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dep_info.pNext = nullptr;
+    dep_info.bufferMemoryBarrierCount = (u32)buffer_barriers.size();
+    dep_info.pBufferMemoryBarriers = buffer_barriers.data();
+    dep_info.imageMemoryBarrierCount = (u32)image_barriers.size();
+    dep_info.pImageMemoryBarriers = image_barriers.data();
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    stream_acquires.clear();
+}
+
+void vk_renderer::destroy_mesh(const vk_gpu_mesh_buffers& mesh) {
+    retire([=]() {
+        destroy_buffer(mesh.index_buffer);
+        destroy_buffer(mesh.vertex_buffer);
+    });
+}
+
+vk_texture vk_renderer::load_texture(const std::string& path, const vk_sampler_desc& sampler) {
+    return texture_manager.load(path, sampler);
+}
+
+vk_texture vk_renderer::create_texture(const void* pixels, VkExtent2D extent, VkFormat format, bool mipmapped, const vk_sampler_desc& sampler) {
+    return texture_manager.create(pixels, extent, format, mipmapped, sampler);
+}
+
+void vk_renderer::destroy_texture(const vk_texture& texture) {
+    retire([=, this]() {
+        texture_manager.destroy_texture(texture);
+    });
+}
+
+void vk_renderer::draw_mesh(const vk_gpu_mesh_buffers& mesh, const glm::mat4& world_matrix, u32 material) {
+    render_queue.submit(materials[material].pipeline, material, mesh, world_matrix);
+}
+
+void vk_renderer::prepare_render_queue() {
+    vk_cpu_scope scope(profiler, "render_queue");
+
+    vk_frame_data& frame = get_current_frame();
+    if(render_queue.size() > frame.instance_capacity) {
+        grow_instance_buffer(frame, render_queue.size());
+    }
+
+    // The slot is idle, so the sorted instances go straight into its mapped buffer
+    render_queue.build((vk_gpu_instance_data*)frame.instance_buffer.info.pMappedData);
+}
+
+void vk_renderer::draw_render_queue(VkCommandBuffer cmd, u32 first_batch, u32 batch_count) {
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+
+    vk_gpu_draw_push_constants push_constants{};
+    push_constants.instance_buffer = get_current_frame().instance_buffer_address;
+    push_constants.virtual_textures = virtual_texture_cache.get_system_address(frame_number % frames.size());
+    push_constants.virtual_texture = test_virtual_texture;
+
+    // Only reads the built queue, so chunks of it can be recorded from several threads at once
+    for(const vk_draw_batch& batch : std::span(render_queue.get_batches()).subspan(first_batch, batch_count)) {
+        // Pipelines that are still compiling are skipped
+        VkPipeline pipeline = *render_pipelines[batch.pipeline];
+        if(pipeline == VK_NULL_HANDLE) continue;
+
+        if(pipeline != bound_pipeline) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = pipeline;
+        }
+
+        if(batch.index_buffer != bound_index_buffer) {
+            vkCmdBindIndexBuffer(cmd, batch.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+            bound_index_buffer = batch.index_buffer;
+        }
+
+        push_constants.vertex_buffer = batch.vertex_buffer;
+        vkCmdPushConstants(cmd, bindless_heap.get_pipeline_layout(), VK_SHADER_STAGE_ALL, 0, sizeof(vk_gpu_draw_push_constants), &push_constants);
+
+        vkCmdDrawIndexed(cmd, batch.index_count, batch.instance_count, 0, 0, batch.first_instance);
+    }
+}
 
-    VK_CHECK(vkWaitForFences(logical_device, 1, &imm_fence, true, 1000000000));
+void vk_renderer::grow_instance_buffer(vk_frame_data& frame, u32 instance_count) {
+    // Only this slot uses the buffer and it is idle, so the old one can go right away
+    if(frame.instance_buffer.buffer != VK_NULL_HANDLE) {
+        destroy_buffer(frame.instance_buffer);
+    }
+
+    frame.instance_capacity = std::max(instance_count, frame.instance_capacity * 2);
+    frame.instance_buffer = create_buffer(frame.instance_capacity * sizeof(vk_gpu_instance_data), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                          VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+    VkBufferDeviceAddressInfo device_address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = frame.instance_buffer.buffer };
+    frame.instance_buffer_address = vkGetBufferDeviceAddress(logical_device, &device_address_info);
 }
 
 void vk_renderer::update_imgui() {
     if (ImGui::Begin("background")) {
-        vk_compute_effect& selected = background_effects[current_background_effect];
+        std::span<const u32> background = effects.get_stage(EFFECT_STAGE_BACKGROUND);
+        vk_compute_effect& selected = effects.get_effect(background[current_background_effect]);
+
+        ImGui::Text("Selected effect: %s", selected.name.c_str());
+
+        ImGui::SliderInt("Effect Index", &current_background_effect, 0, (int)background.size() - 1);
+
+        draw_effect_parameters(selected);
+    }
+
+    ImGui::End();
+
+    if (ImGui::Begin("post effects")) {
+        for(u32 index : effects.get_stage(EFFECT_STAGE_POST)) {
+            vk_compute_effect& effect = effects.get_effect(index);
+
+            ImGui::PushID((int)index);
+            ImGui::Checkbox(effect.name.c_str(), &effect.enabled);
+
+            if(effect.enabled) {
+                draw_effect_parameters(effect);
+            }
+
+            ImGui::PopID();
+        }
+    }
+
+    ImGui::End();
+
+    if (ImGui::Begin("resolution")) {
+        bool enabled = resolution_scaler.is_enabled();
+        if(ImGui::Checkbox("Dynamic resolution", &enabled)) {
+            resolution_scaler.set_enabled(enabled);
+        }
+
+        vk_resolution_scaler_config& scaler_config = resolution_scaler.get_config();
+
+        f32 target_ms = (f32)scaler_config.target_frame_ms;
+        if(ImGui::SliderFloat("Target gpu ms", &target_ms, 1.f, 50.f)) {
+            scaler_config.target_frame_ms = target_ms;
+        }
+
+        ImGui::SliderFloat("Min scale", &scaler_config.min_scale, 0.25f, scaler_config.max_scale);
+
+        ImGui::Text("Scale: %.3f (%ux%u)", resolution_scaler.get_scale(), draw_extent.width, draw_extent.height);
+    }
+
+    ImGui::End();
 
-        ImGui::Text("Selected effect: ", selected.name);
+    if (ImGui::Begin("memory")) {
+        ImGui::Text("%s", memory_budget.has_budget_extension() ? "Budget reported by the driver" : "Budget estimated from the heap sizes");
 
-        ImGui::SliderInt("Effect Index", &current_background_effect, 0, background_effects.size() - 1);
+        std::span<const vk_heap_budget> heaps = memory_budget.get_heaps();
+        for(u32 i = 0; i < heaps.size(); i++) {
+            ImGui::Text("Heap %u%s: %llu / %llu MiB", i, heaps[i].device_local ? " (device local)" : "",
+                        (unsigned long long)(heaps[i].usage >> 20), (unsigned long long)(heaps[i].budget >> 20));
+        }
 
-        ImGui::InputFloat4("data1",(float*)& selected.data.data1);
-        ImGui::InputFloat4("data2",(float*)& selected.data.data2);
-        ImGui::InputFloat4("data3",(float*)& selected.data.data3);
-        ImGui::InputFloat4("data4",(float*)& selected.data.data4);
+        const vk_transient_allocator& transients = render_graph.get_transient_allocator();
+        ImGui::Text("Transients: %llu MiB, %llu MiB without aliasing", (unsigned long long)(transients.get_allocated_bytes() >> 20),
+                    (unsigned long long)(transients.get_requested_bytes() >> 20));
     }
 
     ImGui::End();
 }
 
-void vk_renderer::create_swapchain(u32 width, u32 height) {
+void vk_renderer::draw_effect_parameters(vk_compute_effect& effect) {
+    for(const vk_effect_parameter& parameter : effect.parameters) {
+        const char* name = parameter.name.c_str();
+        void* value = effect.data.data() + parameter.offset;
+
+        switch(parameter.type) {
+            case EFFECT_PARAMETER_COLOR3:
+                ImGui::ColorEdit3(name, (float*)value);
+                break;
+            case EFFECT_PARAMETER_COLOR4:
+                ImGui::ColorEdit4(name, (float*)value);
+                break;
+            case EFFECT_PARAMETER_INT:
+                ImGui::InputScalar(name, ImGuiDataType_S32, value);
+                break;
+            case EFFECT_PARAMETER_UINT:
+                ImGui::InputScalar(name, ImGuiDataType_U32, value);
+                break;
+            default:
+                if(parameter.has_range) {
+                    ImGui::SliderScalarN(name, ImGuiDataType_Float, value, (int)parameter.component_count, &parameter.min, &parameter.max, "%.4f");
+                } else {
+                    ImGui::InputScalarN(name, ImGuiDataType_Float, value, (int)parameter.component_count);
+                }
+                break;
+        }
+    }
+}
+
+void vk_renderer::create_swapchain(u32 width, u32 height, VkSwapchainKHR old_swapchain) {
     vkb::SwapchainBuilder swapchainBuilder{chosen_gpu, logical_device, surface};
 
     swapchain_image_format = VK_FORMAT_B8G8R8A8_SRGB;
 
+    // Passing the old swapchain lets the driver reuse its resources and keep presenting while we switch over
     vkb::Swapchain vkb_swapchain = swapchainBuilder
             .set_desired_format(VkSurfaceFormatKHR{ .format = swapchain_image_format, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
             .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
             .set_desired_extent(width, height)
+            .set_old_swapchain(old_swapchain)
             .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
             .build()
             .value();
@@ -669,24 +1762,20 @@ void vk_renderer::destroy_swapchain() {
     }
 }
 
-void vk_renderer::draw_background(VkCommandBuffer cmd) {
-    vk_compute_effect& effect = background_effects[current_background_effect];
+void vk_renderer::draw_background(VkCommandBuffer cmd, u32 target_image_index) {
+    std::span<const u32> background = effects.get_stage(EFFECT_STAGE_BACKGROUND);
 
-    // Bind the gradient drawing compute pipeline
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipeline);
-
-    // Bind the descriptor set for the draw image
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gradient_pipeline_layout, 0, 1,
-                            &draw_image_descriptors, 0, nullptr);
-
-    vkCmdPushConstants(cmd, gradient_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vk_compute_push_constants), &effect.data);
+    u32 effect = background[current_background_effect];
+    if(effects.get_effect(effect).pipeline == VK_NULL_HANDLE) {
+        effect = background[0]; // Still compiling, draw the fallback instead
+    }
 
-    // execute the compute pipeline dispatch. We are using 16x16 work group so we need to divide by it
-    vkCmdDispatch(cmd, std::ceil(draw_extent.width / 16), std::ceil(draw_extent.width / 16), 1);
+    // The bindless heap is already bound, the effect only needs to know which storage image to write into
+    effects.record(cmd, bindless_heap.get_pipeline_layout(), effect, { target_image_index, draw_extent, 0, effect_sampler_index, (u32)frame_number });
 }
 
 void vk_renderer::draw_imgui(VkCommandBuffer cmd, VkImageView target_image_view) {
-    VkRenderingAttachmentInfo color_attachment = vkinit::attachment_info(target_image_view, nullptr, VK_IMAGE_LAYOUT_GENERAL);
+    VkRenderingAttachmentInfo color_attachment = vkinit::attachment_info(target_image_view, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     VkRenderingInfo renderInfo = vkinit::rendering_info(swapchain_extent, &color_attachment, nullptr);
 
     vkCmdBeginRendering(cmd, &renderInfo);
@@ -696,15 +1785,22 @@ void vk_renderer::draw_imgui(VkCommandBuffer cmd, VkImageView target_image_view)
     vkCmdEndRendering(cmd);
 }
 
-void vk_renderer::draw_geometry(VkCommandBuffer cmd) {
+void vk_renderer::begin_geometry_pass(VkCommandBuffer cmd, bool clear_depth, VkRenderingFlags flags) {
     //begin a render pass  connected to our draw image
-    VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_GENERAL);
+    VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(depth_image.view, clear_depth);
 
-    VkRenderingInfo renderInfo = vkinit::rendering_info(draw_extent, &colorAttachment, nullptr);
+    VkRenderingInfo renderInfo = vkinit::rendering_info(draw_extent, &colorAttachment, &depthAttachment);
+    renderInfo.flags = flags;
     vkCmdBeginRendering(cmd, &renderInfo);
 
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle_pipeline);
+    // A pass recorded in secondaries can only execute them, each one sets the viewport itself
+    if(flags & VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT) return;
+
+    set_draw_viewport(cmd);
+}
 
+void vk_renderer::set_draw_viewport(VkCommandBuffer cmd) {
     //set dynamic viewport and scissor
     VkViewport viewport = {};
     viewport.x = 0;
@@ -723,9 +1819,88 @@ void vk_renderer::draw_geometry(VkCommandBuffer cmd) {
     scissor.extent.height = draw_extent.height;
 
     vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void vk_renderer::draw_geometry(VkCommandBuffer cmd, vk_gpu_cull_phase scene_phase) {
+    // Long queues are split across the recording threads, short ones aren't worth the secondaries
+    u32 batch_count = (u32)render_queue.get_batches().size();
+    u32 batches_per_chunk = std::max(config.batches_per_record_chunk, 1u);
+    u32 chunk_count = std::min((batch_count + batches_per_chunk - 1) / batches_per_chunk, parallel_recorder.get_thread_count());
+
+    if(chunk_count > 1) {
+        draw_geometry_parallel(cmd, scene_phase, chunk_count);
+        return;
+    }
+
+    begin_geometry_pass(cmd, true);
+
+    // Pipelines that are still compiling are skipped
+    if(triangle_pipeline != VK_NULL_HANDLE) {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle_pipeline);
+
+        //launch a draw command to draw 3 vertices
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+    }
+
+    draw_render_queue(cmd, 0, batch_count);
+
+    if(is_gpu_scene_ready()) {
+        gpu_scene.record_draw(cmd, frame_number % frames.size(), scene_phase, indirect_mesh_pipeline, bindless_heap.get_pipeline_layout(), view_projection);
+    }
+
+    vkCmdEndRendering(cmd);
+}
+
+void vk_renderer::draw_geometry_parallel(VkCommandBuffer cmd, vk_gpu_cull_phase scene_phase, u32 chunk_count) {
+    begin_geometry_pass(cmd, true, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
+
+    VkCommandBufferInheritanceRenderingInfo rendering_info = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO};
+    rendering_info.pNext = nullptr;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &draw_image.image_format;
+    rendering_info.depthAttachmentFormat = depth_format;
+    rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    u32 batch_count = (u32)render_queue.get_batches().size();
+    u32 frame_index = frame_number % frames.size();
+
+    // Chunks run in any order on any thread, but execute in chunk order, so the draws keep their sorted order.
+    // The triangle goes first and the gpu scene last, as in the inline path
+    auto record_chunk = [&](VkCommandBuffer secondary, u32 chunk) {
+        // Secondary command buffers don't inherit the descriptor sets bound in the primary one
+        bindless_heap.bind(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS);
+        set_draw_viewport(secondary);
+
+        if(chunk == 0 && triangle_pipeline != VK_NULL_HANDLE) {
+            vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle_pipeline);
+            vkCmdDraw(secondary, 3, 1, 0, 0);
+        }
+
+        u32 first_batch = (u32)((u64)batch_count * chunk / chunk_count);
+        u32 last_batch = (u32)((u64)batch_count * (chunk + 1) / chunk_count);
+        draw_render_queue(secondary, first_batch, last_batch - first_batch);
+
+        if(chunk == chunk_count - 1 && is_gpu_scene_ready()) {
+            gpu_scene.record_draw(secondary, frame_index, scene_phase, indirect_mesh_pipeline, bindless_heap.get_pipeline_layout(), view_projection);
+        }
+    };
+
+    std::span<const VkCommandBuffer> secondaries;
+    {
+        vk_cpu_scope scope(profiler, "parallel_record");
+        secondaries = parallel_recorder.record(frame_index, rendering_info, chunk_count, record_chunk);
+    }
+
+    vkCmdExecuteCommands(cmd, (u32)secondaries.size(), secondaries.data());
+
+    vkCmdEndRendering(cmd);
+}
+
+void vk_renderer::draw_geometry_late(VkCommandBuffer cmd) {
+    // Only the objects the late phase found visible, on top of what the early phase drew
+    begin_geometry_pass(cmd, false);
 
-    //launch a draw command to draw 3 vertices
-    vkCmdDraw(cmd, 3, 1, 0, 0);
+    gpu_scene.record_draw(cmd, frame_number % frames.size(), GPU_CULL_PHASE_LATE, indirect_mesh_pipeline, bindless_heap.get_pipeline_layout(), view_projection);
 
     vkCmdEndRendering(cmd);
 }
\ No newline at end of file
@@ -5,7 +5,26 @@
 #ifndef VK_RENDERER_H
 #define VK_RENDERER_H
 
+#include <future>
+
+#include "vk_depth_pyramid.h"
 #include "vk_descriptors.h"
+#include "vk_effect_registry.h"
+#include "vk_gpu_scene.h"
+#include "vk_memory_budget.h"
+#include "vk_pipeline_cache.h"
+#include "vk_pipeline_compiler.h"
+#include "vk_parallel_recorder.h"
+#include "vk_profiler.h"
+#include "vk_render_graph.h"
+#include "vk_render_queue.h"
+#include "vk_resolution_scaler.h"
+#include "vk_streamer.h"
+#include "vk_shader_watcher.h"
+#include "vk_sync.h"
+#include "vk_textures.h"
+#include "vk_uploader.h"
+#include "vk_virtual_texture.h"
 // #include "renderer/renderer_frontend.h"
 #include "vk_types.h"
 
@@ -31,33 +50,116 @@ struct vk_frame_data {
     VkCommandBuffer command_buffer;
 
     VkSemaphore swapchain_semaphore, render_semaphore;
-    VkFence render_fence;
+    u64 timeline_value; // Graphics timeline value signalled once this frame finished on the gpu
 
-    deletion_queue del_queue;
-};
+    // Async compute, only used when the renderer runs background effects on a dedicated compute queue
+    VkCommandPool compute_command_pool;
+    VkCommandBuffer compute_command_buffer;
+    u64 compute_timeline_value; // Compute timeline value signalled once background_image is written
 
-struct vk_compute_push_constants {
-    glm::vec4 data1;
-    glm::vec4 data2;
-    glm::vec4 data3;
-    glm::vec4 data4;
-};
+    vk_allocated_image background_image;
+    u32 background_image_index; // Storage image index in the bindless heap
+
+    u32 draw_image_generation; // Draw image the background was sized for, it gets resized when the slot is idle
+
+    f32 render_scale; // Resolution scale the frame was rendered at, its gpu time is measured against it
 
-struct vk_compute_effect {
-    const char* name;
+    vk_descriptor_allocator frame_descriptors; // Transient sets, all reset at once when the slot is reused
 
-    VkPipeline pipeline;
-    VkPipelineLayout layout;
+    // Instance data of the render queue, written by the cpu while the slot is idle. Grows on demand
+    vk_allocated_buffer instance_buffer;
+    VkDeviceAddress instance_buffer_address;
+    u32 instance_capacity;
 
-    vk_compute_push_constants data;
+    vk_frame_queries queries;
+};
+
+// Picks the pipeline draw_mesh instances are drawn with
+struct vk_material {
+    u32 pipeline; // Index into the renderer's render pipelines
 };
 
 constexpr u32 FRAME_OVERLAP = 2;
+constexpr u32 DEFAULT_MATERIAL = 0;
+
+struct vk_renderer_config {
+    void* window_ptr = nullptr; // GLFW window to present into, nullptr renders headless into draw_image
+
+    // Draw image size used when running headless, windowed mode takes the size of the window
+    u32 width = 800;
+    u32 height = 600;
+
+    // How many frames the cpu can record ahead of the gpu
+    u32 frames_in_flight = FRAME_OVERLAP;
+
+    // Run background effects on a dedicated compute queue if the gpu has one
+    bool async_compute = false;
+
+    // File the pipeline cache is loaded from at startup and saved to on destroy
+    std::string pipeline_cache_path = "pipeline_cache.bin";
+
+    // Threads compiling pipelines in the background, 0 uses one less than the core count
+    u32 pipeline_compile_threads = 0;
+
+    // Threads helping the render loop record draws into secondary command buffers, 0 uses one less than the core count
+    u32 record_threads = 0;
+
+    // Render queue batches one secondary command buffer records, a frame with fewer batches than two chunks is recorded inline
+    u32 batches_per_record_chunk = 256;
+
+    // Directory the .spv files are loaded from, the build compiles them into SHADER_BINARY_DIR
+    std::string shader_directory = SHADER_BINARY_DIR;
+
+    // Manifest of the background and post effects, in shader_directory
+    std::string effect_manifest = "effects.manifest";
+
+    // Watch shader_directory and rebuild the pipelines whose .spv files change
+    bool hot_reload_shaders = false;
+
+    // Shrink the rendered area of the draw image when the gpu frame time goes over target_frame_ms, the blit upscales it back
+    bool dynamic_resolution = false;
+    f64 target_frame_ms = 16.0;
+    f32 min_render_scale = 0.5f;
+
+    // Size of the persistently mapped ring uploads are staged through, bigger uploads get a buffer of their own
+    u64 staging_buffer_size = 64 * 1024 * 1024;
+
+    // Stream uploads from a background thread on a transfer queue family, when the gpu has one separate from graphics
+    bool transfer_streaming = true;
+
+    // Array sizes of the bindless heap, clamped to what the gpu supports
+    u32 bindless_sampled_images = 16384;
+    u32 bindless_storage_images = 1024;
+    u32 bindless_samplers = 256;
+
+    // Capacity of the gpu driven scene, objects are culled and drawn without any per object cpu work
+    u32 max_scene_objects = 131072;
+    u32 max_scene_vertices = 1024 * 1024;
+    u32 max_scene_indices = 4 * 1024 * 1024;
+
+    // Draw last frame's visible objects first and test the rest against a depth pyramid built from them
+    bool occlusion_culling = true;
+
+    // Fill the scene with a grid of test quads, for measuring the culling and indirect draws
+    u32 test_scene_objects = 0;
+
+    // Physical page cache of the virtual textures, virtual_texture_cache_pages^2 pages of virtual_texture_page_size texels.
+    // Only the pages the screen asks for get loaded, so this bounds their video memory no matter how big the textures are
+    u32 virtual_texture_page_size = 128;
+    u32 virtual_texture_cache_pages = 32;
+    u32 virtual_texture_uploads_per_frame = 32;
+
+    // Tiled virtual texture the test quad samples, empty draws it with the default material
+    std::string virtual_texture_path;
+};
 
 class vk_renderer /*: public renderer*/ {
 public:
-    vk_renderer(void* window_ptr) {
-        this->window_ptr = window_ptr;
+    vk_renderer(void* window_ptr) : vk_renderer(vk_renderer_config{ .window_ptr = window_ptr }) {}
+
+    vk_renderer(const vk_renderer_config& config) {
+        this->config = config;
+        this->window_ptr = config.window_ptr;
 
         init_backend();
     }
@@ -72,6 +174,128 @@ public:
      */
     void draw_frame(); //override;
 
+    /**
+     *  @brief Returns true when the renderer has no window, surface or swapchain
+     */
+    bool is_headless() const { return window_ptr == nullptr; }
+
+    /**
+     *  @brief Returns the image every frame is rendered into.
+     *  In headless mode it is left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL at the end of a frame
+     */
+    const vk_allocated_image& get_draw_image() const { return draw_image; }
+
+    /**
+     *  @brief Returns the frame profiler holding cpu and gpu timings of the recent frames
+     */
+    vk_profiler& get_profiler() { return profiler; }
+
+    /**
+     *  @brief Returns the controller picking the draw extent from the gpu frame times
+     */
+    vk_resolution_scaler& get_resolution_scaler() { return resolution_scaler; }
+
+    /**
+     *  @brief Uploads a mesh into device local index and vertex buffers. The copy is batched with the other uploads
+     *  and submitted at the start of the next frame, so the mesh can be drawn right away
+     */
+    vk_gpu_mesh_buffers upload_mesh(std::span<const u32> indices, std::span<const vk_vertex> vertices);
+
+    /**
+     *  @brief Frees the buffers of a mesh once the frames in flight are done with it
+     */
+    void destroy_mesh(const vk_gpu_mesh_buffers& mesh);
+
+    /**
+     *  @brief Loads a .ktx2 or .dds texture and registers it in the bindless heap. Like meshes, the texels are copied
+     *  at the start of the next frame, so the texture can be sampled right away
+     */
+    vk_texture load_texture(const std::string& path, const vk_sampler_desc& sampler = {});
+
+    /**
+     *  @brief Creates a texture from tightly packed pixels of an uncompressed format, mipmapped ones get their mips generated on the gpu
+     */
+    vk_texture create_texture(const void* pixels, VkExtent2D extent, VkFormat format, bool mipmapped, const vk_sampler_desc& sampler = {});
+
+    /**
+     *  @brief Frees a texture once the frames in flight are done with it
+     */
+    void destroy_texture(const vk_texture& texture);
+
+    /**
+     *  @brief Opens a tiled virtual texture, returns the id shaders pass to vt_sample. Its pages stream in as frames sample them
+     */
+    u32 load_virtual_texture(const std::string& path) { return virtual_texture_cache.load(path); }
+
+    /**
+     *  @brief Returns the usage and budget of every memory heap as of the current frame
+     */
+    const vk_memory_budget& get_memory_budget() const { return memory_budget; }
+
+    /**
+     *  @brief Returns the page cache virtual textures stream through
+     */
+    vk_virtual_texture_cache& get_virtual_texture_cache() { return virtual_texture_cache; }
+
+    /**
+     *  @brief Queues an instance of a mesh to be drawn in the next frame, the queue is cleared after every frame.
+     *  Instances get sorted by pipeline, material and mesh, and instances of the same mesh and material are drawn together
+     */
+    void draw_mesh(const vk_gpu_mesh_buffers& mesh, const glm::mat4& world_matrix, u32 material = DEFAULT_MATERIAL);
+
+    /**
+     *  @brief Returns the uploader batching staging copies, its timeline tells when an upload finished
+     */
+    vk_uploader& get_uploader() { return uploader; }
+
+    /**
+     *  @brief Returns the allocator for descriptor sets that only live for the frame being recorded
+     */
+    vk_descriptor_allocator& get_frame_descriptors() { return get_current_frame().frame_descriptors; }
+
+    /**
+     *  @brief Creates the mesh buffers right away and fills them from the streaming thread, returns the stream request id.
+     *  The mesh can be drawn, and destroyed, once is_stream_complete returns true for the id
+     */
+    u64 stream_mesh(std::span<const u32> indices, std::span<const vk_vertex> vertices, vk_gpu_mesh_buffers& mesh);
+
+    /**
+     *  @brief Returns true once the streamed resources of the request can be used by the next frame
+     */
+    bool is_stream_complete(u64 request_id) const { return request_id <= completed_stream_id; }
+
+    /**
+     *  @brief Returns the scene whose objects are culled on the gpu and drawn with a single indirect draw
+     */
+    vk_gpu_scene& get_gpu_scene() { return gpu_scene; }
+
+    /**
+     *  @brief Sets the camera the gpu scene is culled against and drawn with
+     */
+    void set_view_projection(const glm::mat4& matrix) { view_projection = matrix; }
+
+    /**
+     *  @brief Returns true when background effects run on a dedicated compute queue
+     */
+    bool is_async_compute() const { return use_async_compute; }
+
+    /**
+     *  @brief Returns the number of frames submitted so far, frame N signals N + 1 on the graphics timeline
+     */
+    u64 get_frame_number() const { return frame_number; }
+
+    /**
+     *  @brief Non-blocking check whether the gpu has finished the given frame
+     */
+    bool is_frame_complete(u64 frame) const { return graphics_timeline.is_complete(logical_device, frame + 1); }
+
+    /**
+     *  @brief Queues a function to run once every frame submitted so far, and the one being recorded, has finished on the gpu
+     */
+    void retire(std::function<void()>&& function) {
+        frame_deletion_queue.push_function(graphics_timeline.next_value(), std::move(function));
+    }
+
     // // TODO: This is absolutely shit
     // static void init() {
     //     if(renderer_inst) {
@@ -82,6 +306,7 @@ public:
     //     renderer_inst->init_backend();
     // }
 private:
+    vk_renderer_config config;
     void* window_ptr;
 
     VkInstance instance; // Vk Instance
@@ -96,62 +321,200 @@ private:
     std::vector<VkImageView> swapchain_image_views; // Vk swapchain image views
     VkExtent2D swapchain_extent; // Vk swapchain extent
 
-    u32 frame_number = 0; // Current frame number
+    u64 frame_number = 0; // Current frame number
 
-    vk_frame_data frames[FRAME_OVERLAP];
-    vk_frame_data& get_current_frame() { return frames[frame_number % FRAME_OVERLAP]; }
+    vk_profiler profiler; // Per pass cpu/gpu frame timings
+    vk_resolution_scaler resolution_scaler; // Render scale driven by the gpu frame time
+
+    std::vector<vk_frame_data> frames;
+    vk_frame_data& get_current_frame() { return frames[frame_number % frames.size()]; }
 
     VkQueue graphics_queue; // Vk graphics queue
     u32 graphics_queue_family; // Vk graphics queue family
+    vk_timeline graphics_timeline; // Signalled once per frame submitted to the graphics queue
+
+    bool use_async_compute = false;
+    VkQueue compute_queue; // Vk dedicated compute queue, only valid with async compute
+    u32 compute_queue_family; // Vk dedicated compute queue family
+    vk_timeline compute_timeline; // Signalled once per background effect dispatched on the compute queue
 
     deletion_queue main_deletion_queue;
+    timeline_deletion_queue frame_deletion_queue; // Resources retired by graphics timeline value
+
+    vk_uploader uploader; // Staging ring, submits on the graphics queue ahead of each frame
+
+    bool use_streaming = false;
+    VkQueue transfer_queue; // Vk transfer queue, only valid with streaming
+    u32 transfer_queue_family; // Vk transfer queue family, separate from the graphics and compute families
+    vk_streamer streamer;
+
+    u64 stream_request_count = 0;
+    u64 completed_stream_id = 0; // Requests complete in order, so everything up to this id is usable
+    std::vector<vk_stream_completion> stream_acquires; // Finished requests whose acquire goes into the next frame
+    u64 stream_wait_value = 0; // Streamer timeline value the next graphics submit has to wait for
+
+    void begin_frame();
+    void submit_async_background();
+    void submit_graphics(VkCommandBuffer cmd, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore);
 
     VmaAllocator allocator; // VMA allocator
 
     // Draw resources
-    vk_allocated_image draw_image;
+    vk_allocated_image draw_image; // Sized to the largest swapchain so far, only the draw_extent part gets used
+    VkFormat depth_format = VK_FORMAT_D32_SFLOAT; // Depth is reversed so it gets cleared to 0
+    vk_transient_image depth_image{}; // Same size as draw_image, a transient of the render graph. Valid while the frame's passes get recorded
     VkExtent2D draw_extent;
+    u32 draw_image_generation = 0; // Bumped every time the draw image is reallocated
 
-    vk_descriptor_allocator global_descriptor_allocator;
+    bool resize_requested = false;
 
-    VkDescriptorSet draw_image_descriptors;
-    VkDescriptorSetLayout draw_image_descriptor_layout;
+    vk_bindless_heap bindless_heap; // Every image and sampler, bound once per command buffer
+    u32 draw_image_index; // Storage image index of the draw image in the bindless heap
 
-    VkPipeline gradient_pipeline;
-    VkPipelineLayout gradient_pipeline_layout;
+    vk_shader_registry shader_registry;
+    vk_pipeline_cache pipeline_cache;
+    vk_pipeline_compiler pipeline_compiler;
 
-    // Immediate submit structures
-    VkFence imm_fence;
-    VkCommandPool imm_command_pool;
-    VkCommandBuffer imm_command_buffer;
+    vk_shader_watcher shader_watcher;
 
-    // Compute effects
-    std::vector<vk_compute_effect> background_effects;
-    int current_background_effect{0};
+    // Pipelines still being built on the compiler workers
+    struct pending_pipeline {
+        std::future<VkPipeline> future;
+        std::function<void(VkPipeline)> install;
+        bool is_reload; // Failed reloads keep the old pipeline instead of throwing
+    };
+    std::vector<pending_pipeline> pending_pipelines;
+
+    // Pipelines that get rebuilt when one of their shaders changes
+    struct reloadable_pipeline {
+        std::vector<std::string> shader_paths;
+        std::function<void()> rebuild;
+    };
+    std::vector<reloadable_pipeline> reloadable_pipelines;
+
+    VkPipeline gradient_pipeline;
+
+    // Compute effects, built from the manifest
+    vk_effect_registry effects;
+    int current_background_effect{0}; // Index into the background stage of effects
+    u32 effect_sampler_index; // Linear clamped sampler handed to every effect
 
     VkPipelineLayout triangle_pipeline_layout;
     VkPipeline triangle_pipeline;
+    vk_graphics_pipeline_desc triangle_pipeline_desc;
+
+    VkPipeline mesh_pipeline;
+    vk_graphics_pipeline_desc mesh_pipeline_desc;
+
+    vk_render_graph render_graph; // Passes of the frame being recorded, rebuilt every frame
+
+    vk_memory_budget memory_budget; // Usage and budget of every heap, refreshed every frame
+    vk_render_queue render_queue; // Instances queued with draw_mesh for the next frame
+    vk_parallel_recorder parallel_recorder; // Records the render queue in chunks when it gets long
+    u32 mesh_count = 0; // Hands out mesh ids
+
+    // Materials reference the pipelines by index, so a pipeline swapped in by hot reload is picked up right away
+    std::vector<VkPipeline*> render_pipelines;
+    std::vector<vk_material> materials;
+
+    vk_gpu_mesh_buffers rectangle; // Test mesh, drawn every frame
+
+    vk_texture_manager texture_manager;
+    vk_virtual_texture_cache virtual_texture_cache;
+
+    VkPipeline virtual_texture_pipeline;
+    vk_graphics_pipeline_desc virtual_texture_pipeline_desc;
+    u32 virtual_texture_material; // Only valid with config.virtual_texture_path set
+    u32 test_virtual_texture = 0; // Id of the texture loaded from config.virtual_texture_path
+
+    vk_gpu_scene gpu_scene;
+    glm::mat4 view_projection{ 1.f };
+
+    VkPipeline cull_pipeline;
+    std::string cull_shader_path;
+
+    VkPipeline indirect_mesh_pipeline;
+    vk_graphics_pipeline_desc indirect_mesh_pipeline_desc;
+
+    vk_depth_pyramid depth_pyramid; // Rebuilt from the depth of the early phase every frame
+    VkPipeline depth_pyramid_pipeline;
+    std::string depth_pyramid_shader_path;
+
+    // Both scene pipelines have to be built before the scene can be culled and drawn
+    bool is_gpu_scene_ready() const {
+        return cull_pipeline != VK_NULL_HANDLE && indirect_mesh_pipeline != VK_NULL_HANDLE && gpu_scene.get_object_count() > 0;
+    }
+
+    bool is_occlusion_culling_ready() const {
+        return config.occlusion_culling && depth_pyramid_pipeline != VK_NULL_HANDLE && is_gpu_scene_ready();
+    }
 
     void init_vulkan();
     void init_swapchain();
     void init_commands();
     void init_sync_structures();
+    void init_async_compute();
     void init_descriptors();
     void init_pipelines();
-    void init_background_pipelines();
+    void init_effect_pipelines();
     void init_triangle_pipeline();
+    void init_mesh_pipeline();
+    void init_virtual_texture_pipeline();
+    void init_gpu_scene();
+    void init_gpu_scene_pipelines();
+    void init_default_data();
     void init_imgui();
 
-    void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
+    void queue_effect(u32 index, bool is_reload);
+    void queue_triangle_pipeline(bool is_reload);
+    void queue_mesh_pipeline(bool is_reload);
+    void queue_virtual_texture_pipeline(bool is_reload);
+    void queue_cull_pipeline(bool is_reload);
+    void queue_indirect_mesh_pipeline(bool is_reload);
+    void queue_depth_pyramid_pipeline(bool is_reload);
+    void queue_pipeline(std::future<VkPipeline>&& future, std::function<void(VkPipeline)>&& install, bool is_reload);
+    void install_ready_pipelines(bool wait);
+    void swap_pipeline(VkPipeline& target, VkPipeline pipeline);
+    void reload_changed_shaders();
+
+    std::string get_shader_path(const char* file_name) const;
+
+    vk_allocated_buffer create_buffer(size_t alloc_size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage);
+    void destroy_buffer(const vk_allocated_buffer& buffer);
 
     void update_imgui();
 
-    void draw_background(VkCommandBuffer cmd);
+    // Edits the parameters of an effect, with a widget matching the type of each
+    void draw_effect_parameters(vk_compute_effect& effect);
+
+    void draw_frame_headless();
+
+    // Records the whole frame into cmd, add_output_passes gets the draw image's graph handle and adds the passes
+    // presenting or reading it back. It has to mark the graph's output
+    void record_frame(VkCommandBuffer cmd, const std::function<void(u32)>& add_output_passes);
+    u32 build_scene_graph(VkCommandBuffer cmd);
+    vk_graph_pass& add_graph_pass(const char* name, std::function<void(VkCommandBuffer)>&& record);
+    void record_stream_acquires(VkCommandBuffer cmd);
+
+    void draw_background(VkCommandBuffer cmd, u32 target_image_index);
     void draw_imgui(VkCommandBuffer cmd, VkImageView target_image_view);
-    void draw_geometry(VkCommandBuffer cmd);
+    void begin_geometry_pass(VkCommandBuffer cmd, bool clear_depth, VkRenderingFlags flags = 0);
+    void set_draw_viewport(VkCommandBuffer cmd);
+    void draw_geometry(VkCommandBuffer cmd, vk_gpu_cull_phase scene_phase);
+    void draw_geometry_late(VkCommandBuffer cmd);
 
-    void create_swapchain(u32 width, u32 height);
+    void prepare_render_queue();
+    void draw_render_queue(VkCommandBuffer cmd, u32 first_batch, u32 batch_count);
+    void draw_geometry_parallel(VkCommandBuffer cmd, vk_gpu_cull_phase scene_phase, u32 chunk_count);
+    void grow_instance_buffer(vk_frame_data& frame, u32 instance_count);
+
+    void create_swapchain(u32 width, u32 height, VkSwapchainKHR old_swapchain);
     void destroy_swapchain();
+    bool resize_swapchain();
+
+    void create_draw_image(VkExtent3D extent);
+    void create_background_image(vk_frame_data& frame);
+    void destroy_background_image(vk_frame_data& frame);
 protected:
     /**
      *  @brief Initializes the renderer
@@ -0,0 +1,76 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_resolution_scaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Frames the gpu has to stay comfortably under budget before the resolution goes back up
+constexpr u32 SCALER_GROW_DELAY = 30;
+
+// Scale steps are quantized so small timing noise doesn't resize the draw extent every frame
+constexpr f32 SCALER_STEP = 1.0f / 32.0f;
+
+void vk_resolution_scaler::init(const vk_resolution_scaler_config& config) {
+    this->config = config;
+
+    scale = config.max_scale;
+    smoothed_ms = 0.0;
+    frames_under_budget = 0;
+}
+
+void vk_resolution_scaler::update(f64 gpu_frame_ms, f32 frame_scale) {
+    if(!enabled || gpu_frame_ms <= 0.0 || frame_scale <= 0.f) return;
+
+    // Normalize to the current scale, otherwise frames still in flight from before a drop would push it down again
+    f64 pixel_ratio = ((f64)scale * scale) / ((f64)frame_scale * frame_scale);
+    f64 frame_ms = gpu_frame_ms * pixel_ratio;
+
+    smoothed_ms = smoothed_ms == 0.0 ? frame_ms : smoothed_ms * 0.8 + frame_ms * 0.2;
+
+    // Gpu time is roughly proportional to the pixel count, so the scale that hits the budget is the square root of the ratio
+    f64 target_scale = scale * std::sqrt(config.target_frame_ms / smoothed_ms);
+
+    // Drop right away under a spike, a single slow sample is enough to miss the budget
+    if(frame_ms > config.target_frame_ms) {
+        target_scale = std::min(target_scale, scale * std::sqrt(config.target_frame_ms / frame_ms));
+        frames_under_budget = 0;
+    } else if(smoothed_ms < config.target_frame_ms * 0.85) {
+        frames_under_budget++;
+    } else {
+        frames_under_budget = 0;
+    }
+
+    f32 new_scale = std::floor((f32)target_scale / SCALER_STEP) * SCALER_STEP;
+    new_scale = std::clamp(new_scale, config.min_scale, config.max_scale);
+
+    if(new_scale < scale) {
+        scale = new_scale;
+        frames_under_budget = 0;
+    } else if(new_scale > scale && frames_under_budget >= SCALER_GROW_DELAY) {
+        // Grow one step at a time, overshooting would just make it drop again
+        scale = std::min(scale + SCALER_STEP, config.max_scale);
+        frames_under_budget = 0;
+    }
+}
+
+VkExtent2D vk_resolution_scaler::scale_extent(VkExtent2D extent) const {
+    VkExtent2D scaled;
+    scaled.width = std::max(1u, (u32)((f32)extent.width * scale));
+    scaled.height = std::max(1u, (u32)((f32)extent.height * scale));
+
+    return scaled;
+}
+
+void vk_resolution_scaler::set_enabled(bool enabled) {
+    this->enabled = enabled;
+
+    if(!enabled) {
+        scale = config.max_scale;
+    }
+
+    smoothed_ms = 0.0;
+    frames_under_budget = 0;
+}
@@ -0,0 +1,48 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_RESOLUTION_SCALER_H
+#define VK_RESOLUTION_SCALER_H
+
+#include "vk_types.h"
+
+struct vk_resolution_scaler_config {
+    f64 target_frame_ms = 16.0; // Gpu frame budget the scale is tuned to hit
+    f32 min_scale = 0.5f;
+    f32 max_scale = 1.0f;
+};
+
+// Picks the fraction of the draw image to render into from the measured gpu frame times.
+// The scale applies per axis, so the pixel count goes with its square
+class vk_resolution_scaler {
+public:
+    void init(const vk_resolution_scaler_config& config);
+
+    /**
+     *  @brief Feeds a new gpu frame time in milliseconds and updates the scale.
+     *  frame_scale is the scale that frame was rendered at, which lags behind the current one by the frames in flight
+     */
+    void update(f64 gpu_frame_ms, f32 frame_scale);
+
+    /**
+     *  @brief Returns the extent scaled down by the current scale, never smaller than 1x1
+     */
+    VkExtent2D scale_extent(VkExtent2D extent) const;
+
+    f32 get_scale() const { return scale; }
+    void set_enabled(bool enabled);
+    bool is_enabled() const { return enabled; }
+
+    vk_resolution_scaler_config& get_config() { return config; }
+
+private:
+    vk_resolution_scaler_config config;
+
+    bool enabled = true;
+    f32 scale = 1.0f;
+    f64 smoothed_ms = 0.0; // Moving average of the frame times, one slow frame shouldn't drop the resolution
+    u32 frames_under_budget = 0;
+};
+
+#endif //VK_RESOLUTION_SCALER_H
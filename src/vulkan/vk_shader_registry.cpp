@@ -0,0 +1,231 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_shader_registry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr u32 SPIRV_MAGIC = 0x07230203;
+constexpr u64 SPIRV_HEADER_SIZE = 5 * sizeof(u32);
+
+// Read-only memory mapping of a whole file
+struct mapped_file {
+    const void* data = nullptr;
+    u64 size = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+    bool map(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER file_size;
+        if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return false;
+        size = (u64)file_size.QuadPart;
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!mapping) return false;
+
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        size = (u64)file_stat.st_size;
+
+        // The mapping keeps the file alive, we don't need the descriptor anymore
+        void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if(ptr == MAP_FAILED) return false;
+
+        data = ptr;
+        return true;
+#endif
+    }
+
+    ~mapped_file() {
+#ifdef _WIN32
+        if(data) UnmapViewOfFile(data);
+        if(mapping) CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if(data) munmap((void*)data, size);
+#endif
+    }
+};
+
+// FNV-1a, plenty for telling shader binaries apart
+static u64 hash_spirv(const u32* code, u64 word_count) {
+    u64 hash = 14695981039346656037ull;
+    for(u64 i = 0; i < word_count; i++) {
+        hash ^= code[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+void vk_shader_registry::init(VkDevice device) {
+    this->device = device;
+}
+
+void vk_shader_registry::destroy() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for(auto& info : modules) {
+        vkDestroyShaderModule(device, info.module, nullptr);
+    }
+
+    modules.clear();
+    invalidated.clear();
+    handles_by_path.clear();
+    handles_by_hash.clear();
+}
+
+vk_shader_handle vk_shader_registry::load(const std::string& file_path) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::string path = canonical_path(file_path);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = handles_by_path.find(path);
+        if(it != handles_by_path.end()) return it->second;
+    }
+
+    mapped_file file;
+    if(!file.map(path)) {
+        LOG_THROW("Failed to load shader " + file_path + " (working directory: " + std::filesystem::current_path().string() + ")");
+    }
+
+    // Mappings are page aligned, but vulkan only takes SPIR-V as whole aligned words so check anyway
+    const u32* code = (const u32*)file.data;
+    if((uintptr_t)code % alignof(u32) != 0 || file.size % sizeof(u32) != 0 || file.size < SPIRV_HEADER_SIZE) {
+        LOG_THROW("Shader " + path + " is not a whole number of SPIR-V words");
+    }
+
+    if(code[0] != SPIRV_MAGIC) {
+        LOG_THROW("Shader " + path + " is not SPIR-V (bad magic number)");
+    }
+
+    u64 content_hash = hash_spirv(code, file.size / sizeof(u32));
+
+    {
+        // A copy of a shader we already have under another name
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = handles_by_hash.find(content_hash);
+        if(it != handles_by_hash.end()) {
+            handles_by_path[path] = it->second;
+            return it->second;
+        }
+    }
+
+    // Straight from the mapping, no intermediate copy
+    VkShaderModuleCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.pNext = nullptr;
+    create_info.codeSize = file.size;
+    create_info.pCode = code;
+
+    VkShaderModule module;
+    VK_CHECK(vkCreateShaderModule(device, &create_info, nullptr, &module));
+
+    auto end = std::chrono::high_resolution_clock::now();
+    f64 load_ms = std::chrono::duration<f64, std::milli>(end - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Another thread may have loaded the same shader while we weren't holding the lock
+    auto it = handles_by_hash.find(content_hash);
+    if(it != handles_by_hash.end()) {
+        vkDestroyShaderModule(device, module, nullptr);
+
+        handles_by_path[path] = it->second;
+        return it->second;
+    }
+
+    vk_shader_handle handle = (vk_shader_handle)modules.size();
+    modules.push_back({ path, content_hash, file.size, load_ms, module });
+    handles_by_path[path] = handle;
+    handles_by_hash[content_hash] = handle;
+
+    LOG_INFO("Shader: loaded " << path << " (" << file.size << " bytes) in " << load_ms << "ms");
+
+    return handle;
+}
+
+void vk_shader_registry::invalidate(const std::string& file_path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Pipelines don't need their modules once they are created, but builds queued before the change may still be creating theirs.
+    // The old module goes away in release_invalidated once those are done
+    auto it = handles_by_path.find(canonical_path(file_path));
+    if(it == handles_by_path.end()) return;
+
+    invalidated.push_back(it->second);
+    handles_by_path.erase(it);
+}
+
+void vk_shader_registry::release_invalidated() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for(vk_shader_handle handle : invalidated) {
+        vk_shader_module_info& info = modules[handle];
+        if(info.module == VK_NULL_HANDLE) continue;
+
+        // The new file may have come back with the same content, or another path may share the module
+        bool still_used = std::any_of(handles_by_path.begin(), handles_by_path.end(), [&](const auto& entry) { return entry.second == handle; });
+        if(still_used) continue;
+
+        vkDestroyShaderModule(device, info.module, nullptr);
+        info.module = VK_NULL_HANDLE;
+        handles_by_hash.erase(info.content_hash);
+    }
+
+    invalidated.clear();
+}
+
+std::string vk_shader_registry::canonical_path(const std::string& file_path) {
+    // The same file can be reached through different relative paths
+    std::error_code ec;
+    std::string path = std::filesystem::weakly_canonical(file_path, ec).string();
+
+    return ec ? file_path : path;
+}
+
+VkShaderModule vk_shader_registry::get(vk_shader_handle handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return modules.at(handle).module;
+}
+
+vk_shader_module_info vk_shader_registry::get_info(vk_shader_handle handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return modules.at(handle);
+}
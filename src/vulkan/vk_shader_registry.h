@@ -0,0 +1,64 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_SHADER_REGISTRY_H
+#define VK_SHADER_REGISTRY_H
+
+#include <mutex>
+#include <unordered_map>
+
+#include "vk_types.h"
+
+typedef u32 vk_shader_handle;
+constexpr vk_shader_handle INVALID_SHADER_HANDLE = ~0u;
+
+struct vk_shader_module_info {
+    std::string path;
+    u64 content_hash;
+    u64 size; // SPIR-V size in bytes
+    f64 load_ms; // Time it took to map, validate and create the module
+    VkShaderModule module;
+};
+
+// Owns every shader module, loaded once per path and content no matter how many pipelines use it
+class vk_shader_registry {
+public:
+    void init(VkDevice device);
+    void destroy();
+
+    /**
+     *  @brief Maps the SPIR-V file and creates its module, or returns the handle of an already loaded one.
+     *  Safe to call from any thread, throws if the file is missing or not valid SPIR-V
+     */
+    vk_shader_handle load(const std::string& file_path);
+
+    /**
+     *  @brief Forgets which module a path resolved to, the next load of it maps the file again
+     */
+    void invalidate(const std::string& file_path);
+
+    /**
+     *  @brief Destroys the modules of invalidated paths that nothing loads anymore. Call it when no pipeline build is pending,
+     *  their handles are invalid afterwards
+     */
+    void release_invalidated();
+
+    /**
+     *  @brief Returns the path shaders are keyed by, different relative paths to one file give the same result
+     */
+    static std::string canonical_path(const std::string& file_path);
+
+    VkShaderModule get(vk_shader_handle handle);
+    vk_shader_module_info get_info(vk_shader_handle handle);
+private:
+    VkDevice device;
+
+    std::mutex mutex;
+    std::vector<vk_shader_module_info> modules; // Indexed by handle
+    std::unordered_map<std::string, vk_shader_handle> handles_by_path;
+    std::unordered_map<u64, vk_shader_handle> handles_by_hash;
+    std::vector<vk_shader_handle> invalidated; // Modules waiting for release_invalidated
+};
+
+#endif //VK_SHADER_REGISTRY_H
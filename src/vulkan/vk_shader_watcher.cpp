@@ -0,0 +1,96 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_shader_watcher.h"
+
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+void vk_shader_watcher::init(const std::string& directory) {
+    this->directory = directory;
+
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotify_fd < 0) {
+        LOG_INFO("Shader watcher: failed to initialize inotify, hot reload is disabled");
+        return;
+    }
+
+    // Compilers either rewrite the file in place or move a finished temporary file over it
+    if(inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        LOG_INFO("Shader watcher: failed to watch " << directory << ", hot reload is disabled");
+        close(inotify_fd);
+        inotify_fd = -1;
+        return;
+    }
+
+    stopping = false;
+    thread = std::thread(&vk_shader_watcher::watch_loop, this);
+
+    LOG_INFO("Shader watcher: watching " << directory);
+#else
+    LOG_INFO("Shader watcher: not supported on this platform, hot reload is disabled");
+#endif
+}
+
+void vk_shader_watcher::destroy() {
+#ifdef __linux__
+    stopping = true;
+
+    if(thread.joinable()) {
+        thread.join();
+    }
+
+    if(inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+#endif
+}
+
+std::vector<std::string> vk_shader_watcher::poll_changes() {
+    std::lock_guard<std::mutex> lock(changes_mutex);
+
+    std::vector<std::string> changed(changes.begin(), changes.end());
+    changes.clear();
+
+    return changed;
+}
+
+void vk_shader_watcher::watch_loop() {
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+
+    while(!stopping) {
+        // Wake up regularly to check whether we should stop
+        pollfd fd = { .fd = inotify_fd, .events = POLLIN, .revents = 0 };
+        if(poll(&fd, 1, 100) <= 0) continue;
+
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if(length <= 0) continue;
+
+        for(char* ptr = buffer; ptr < buffer + length;) {
+            inotify_event* event = (inotify_event*)ptr;
+            ptr += sizeof(inotify_event) + event->len;
+
+            if(event->len == 0) continue;
+
+            std::filesystem::path path = std::filesystem::path(directory) / event->name;
+            if(path.extension() != ".spv") continue;
+
+            std::error_code ec;
+            std::string canonical = std::filesystem::weakly_canonical(path, ec).string();
+
+            // Several events for one file between two frames only trigger one rebuild
+            std::lock_guard<std::mutex> lock(changes_mutex);
+            changes.insert(ec ? path.string() : canonical);
+        }
+    }
+#endif
+}
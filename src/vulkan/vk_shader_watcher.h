@@ -0,0 +1,38 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_SHADER_WATCHER_H
+#define VK_SHADER_WATCHER_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "vk_types.h"
+
+// Watches a directory for rewritten .spv files on a background thread. Only implemented with inotify, elsewhere it never reports anything
+class vk_shader_watcher {
+public:
+    void init(const std::string& directory);
+    void destroy();
+
+    /**
+     *  @brief Returns the canonical paths of the .spv files changed since the last call, never blocks
+     */
+    std::vector<std::string> poll_changes();
+private:
+    void watch_loop();
+
+    std::string directory;
+
+    int inotify_fd = -1;
+    std::thread thread;
+    std::atomic<bool> stopping = false;
+
+    std::mutex changes_mutex;
+    std::unordered_set<std::string> changes;
+};
+
+#endif //VK_SHADER_WATCHER_H
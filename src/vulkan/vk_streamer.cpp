@@ -0,0 +1,104 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_streamer.h"
+
+#include <chrono>
+
+#include "vk_images.h"
+
+void vk_streamer::init(VkDevice device, VmaAllocator allocator, VkQueue transfer_queue, u32 transfer_family, u32 dst_family, VkDeviceSize staging_size) {
+    this->src_family = transfer_family;
+    this->dst_family = dst_family;
+
+    // The uploader gets its own command pool on the transfer family and releases everything it writes to the render queue
+    uploader.init(device, allocator, transfer_queue, transfer_family, staging_size);
+    uploader.set_ownership_transfer(transfer_family, dst_family);
+
+    timeline_semaphore = uploader.get_timeline().semaphore;
+
+    stopping = false;
+    worker = std::thread(&vk_streamer::worker_loop, this);
+}
+
+void vk_streamer::destroy() {
+    {
+        std::lock_guard lock(request_mutex);
+        stopping = true;
+    }
+
+    request_cv.notify_one();
+
+    if(worker.joinable()) {
+        worker.join();
+    }
+
+    uploader.destroy();
+}
+
+void vk_streamer::submit(vk_stream_request&& request) {
+    {
+        std::lock_guard lock(request_mutex);
+        requests.push_back(std::move(request));
+    }
+
+    request_cv.notify_one();
+}
+
+void vk_streamer::worker_loop() {
+    std::vector<vk_stream_request> batch;
+
+    while(true) {
+        {
+            std::unique_lock lock(request_mutex);
+
+            // Wake up now and then even without requests, finished batches still have staging memory to give back
+            request_cv.wait_for(lock, std::chrono::milliseconds(100), [this]() { return stopping || !requests.empty(); });
+
+            if(stopping) break;
+
+            batch.swap(requests);
+        }
+
+        uploader.collect();
+
+        if(batch.empty()) continue;
+
+        // Everything that arrived since the last wake up goes out in one submission
+        for(vk_stream_request& request : batch) {
+            for(vk_stream_buffer_upload& upload : request.buffers) {
+                uploader.upload_buffer(upload.dst, 0, upload.data.data(), upload.data.size());
+            }
+
+            for(vk_stream_image_upload& upload : request.images) {
+                uploader.upload_image(upload.dst, upload.data.data(), upload.data.size(), upload.final_layout);
+            }
+        }
+
+        u64 value = uploader.flush();
+
+        for(vk_stream_request& request : batch) {
+            vk_stream_completion completion{};
+            completion.id = request.id;
+            completion.value = value;
+
+            // The acquires have to match the releases the uploader recorded
+            for(vk_stream_buffer_upload& upload : request.buffers) {
+                completion.buffer_acquires.push_back(vkutil::buffer_ownership_barrier(upload.dst, 0, upload.data.size(), src_family, dst_family, false));
+            }
+
+            for(vk_stream_image_upload& upload : request.images) {
+                completion.image_acquires.push_back(vkutil::image_ownership_barrier(upload.dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.final_layout,
+                                                                                    src_family, dst_family, false));
+            }
+
+            // The render thread drains the queue every frame, so it only fills up when frames stall
+            while(!completions.push(std::move(completion)) && !stopping) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        batch.clear();
+    }
+}
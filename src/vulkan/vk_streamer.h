@@ -0,0 +1,84 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_STREAMER_H
+#define VK_STREAMER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "vk_sync.h"
+#include "vk_types.h"
+#include "vk_uploader.h"
+
+struct vk_stream_buffer_upload {
+    VkBuffer dst;
+    std::vector<u8> data;
+};
+
+struct vk_stream_image_upload {
+    vk_allocated_image dst;
+    std::vector<u8> data;
+    VkImageLayout final_layout;
+};
+
+// Resources are created by the caller, the streamer only fills them
+struct vk_stream_request {
+    u64 id;
+    std::vector<vk_stream_buffer_upload> buffers;
+    std::vector<vk_stream_image_upload> images;
+};
+
+// Handed back to the render thread once the copies of a request were submitted.
+// The render thread waits for value on the streamer's timeline and records the acquire barriers before touching the resources
+struct vk_stream_completion {
+    u64 id;
+    u64 value;
+
+    std::vector<VkBufferMemoryBarrier2> buffer_acquires;
+    std::vector<VkImageMemoryBarrier2> image_acquires;
+};
+
+// Uploads on a transfer queue from a thread of its own, finished requests come back through a lock-free queue
+class vk_streamer {
+public:
+    void init(VkDevice device, VmaAllocator allocator, VkQueue transfer_queue, u32 transfer_family, u32 dst_family, VkDeviceSize staging_size);
+
+    /**
+     *  @brief Stops the thread and waits for every submitted copy
+     */
+    void destroy();
+
+    /**
+     *  @brief Queues a request for the streaming thread, requests complete in the order they were queued
+     */
+    void submit(vk_stream_request&& request);
+
+    /**
+     *  @brief Pops the next finished request, only call this from the render thread
+     */
+    bool poll(vk_stream_completion& completion) { return completions.pop(completion); }
+
+    VkSemaphore get_timeline_semaphore() const { return timeline_semaphore; }
+
+private:
+    void worker_loop();
+
+    VkSemaphore timeline_semaphore; // The uploader's timeline, cached so the render thread never touches the uploader
+    u32 src_family;
+    u32 dst_family;
+
+    vk_uploader uploader; // Only used by the worker thread after init
+    std::thread worker;
+
+    std::mutex request_mutex;
+    std::condition_variable request_cv;
+    std::vector<vk_stream_request> requests;
+    std::atomic<bool> stopping{false};
+
+    vk_spsc_queue<vk_stream_completion, 256> completions;
+};
+
+#endif //VK_STREAMER_H
@@ -0,0 +1,49 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_sync.h"
+
+#include "vk_initializers.h"
+
+void vk_timeline::init(VkDevice device) {
+    VkSemaphoreTypeCreateInfo type_info = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    type_info.pNext = nullptr;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = vkinit::semaphore_create_info(0);
+    semaphore_info.pNext = &type_info;
+
+    VK_CHECK(vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore));
+
+    submitted_value = 0;
+}
+
+void vk_timeline::destroy(VkDevice device) {
+    vkDestroySemaphore(device, semaphore, nullptr);
+}
+
+u64 vk_timeline::get_completed_value(VkDevice device) const {
+    u64 value;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, semaphore, &value));
+
+    return value;
+}
+
+VkResult vk_timeline::wait(VkDevice device, u64 value, u64 timeout) const {
+    VkSemaphoreWaitInfo wait_info = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    wait_info.pNext = nullptr;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &semaphore;
+    wait_info.pValues = &value;
+
+    return vkWaitSemaphores(device, &wait_info, timeout);
+}
+
+VkSemaphoreSubmitInfo vk_timeline::submit_info(VkPipelineStageFlags2 stage_mask, u64 value) const {
+    VkSemaphoreSubmitInfo info = vkinit::semaphore_submit_info(stage_mask, semaphore);
+    info.value = value;
+
+    return info;
+}
@@ -0,0 +1,100 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_SYNC_H
+#define VK_SYNC_H
+
+#include <atomic>
+
+#include "vk_types.h"
+
+// A timeline semaphore counting the submissions made to a single queue
+struct vk_timeline {
+    VkSemaphore semaphore;
+    u64 submitted_value; // Last value a submission was told to signal
+
+    void init(VkDevice device);
+    void destroy(VkDevice device);
+
+    /**
+     *  @brief Returns the value the next submission to the queue should signal
+     */
+    u64 next_value() const { return submitted_value + 1; }
+
+    /**
+     *  @brief Marks the next value as submitted and returns it
+     */
+    u64 advance() { return ++submitted_value; }
+
+    u64 get_completed_value(VkDevice device) const;
+
+    /**
+     *  @brief Non-blocking check whether the gpu has reached the value
+     */
+    bool is_complete(VkDevice device, u64 value) const { return get_completed_value(device) >= value; }
+
+    /**
+     *  @brief Blocks until the gpu has reached the value, returns VK_TIMEOUT if it didn't within timeout nanoseconds
+     */
+    VkResult wait(VkDevice device, u64 value, u64 timeout) const;
+
+    VkSemaphoreSubmitInfo submit_info(VkPipelineStageFlags2 stage_mask, u64 value) const;
+};
+
+// Deletion queue whose entries run once the timeline they were retired on has reached their value
+struct timeline_deletion_queue {
+    std::deque<std::pair<u64, std::function<void()>>> deletors;
+
+    void push_function(u64 value, std::function<void()>&& function) {
+        deletors.emplace_back(value, std::move(function));
+    }
+
+    // Values only increase, so the entries are sorted and we can stop at the first one that isn't done yet
+    void collect(u64 completed_value) {
+        while(!deletors.empty() && deletors.front().first <= completed_value) {
+            deletors.front().second();
+            deletors.pop_front();
+        }
+    }
+
+    void flush() {
+        collect(~0ull);
+    }
+};
+
+// Lock-free queue between exactly one producer and one consumer thread. Capacity has to be a power of two
+template<typename T, u32 Capacity>
+struct vk_spsc_queue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "vk_spsc_queue capacity has to be a power of two");
+
+    std::array<T, Capacity> items;
+    std::atomic<u32> head{0}; // Next slot the consumer reads, only written by the consumer
+    std::atomic<u32> tail{0}; // Next slot the producer writes, only written by the producer
+
+    // Producer side, returns false when the queue is full
+    bool push(T&& item) {
+        u32 current_tail = tail.load(std::memory_order_relaxed);
+        if(current_tail - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+
+        items[current_tail & (Capacity - 1)] = std::move(item);
+        tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false when the queue is empty
+    bool pop(T& item) {
+        u32 current_head = head.load(std::memory_order_relaxed);
+        if(current_head == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = std::move(items[current_head & (Capacity - 1)]);
+        head.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif //VK_SYNC_H
@@ -0,0 +1,502 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_textures.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "vk_initializers.h"
+
+constexpr VkDeviceSize TEXTURE_LEVEL_ALIGNMENT = 16; // Buffer to image copies need offsets aligned to the texel block
+
+// Size of a texel block and how many texels it covers per side
+struct texture_block_info {
+    u32 bytes;
+    u32 size;
+};
+
+static bool get_block_info(VkFormat format, texture_block_info& info) {
+    switch(format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            info = { 8, 4 };
+            return true;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            info = { 16, 4 };
+            return true;
+        case VK_FORMAT_R8_UNORM:
+            info = { 1, 1 };
+            return true;
+        case VK_FORMAT_R8G8_UNORM:
+            info = { 2, 1 };
+            return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            info = { 4, 1 };
+            return true;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            info = { 8, 1 };
+            return true;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            info = { 16, 1 };
+            return true;
+        default:
+            return false;
+    }
+}
+
+static u64 get_level_size(const texture_block_info& block, VkExtent3D extent) {
+    u64 blocks_x = (extent.width + block.size - 1) / block.size;
+    u64 blocks_y = (extent.height + block.size - 1) / block.size;
+    return blocks_x * blocks_y * block.bytes;
+}
+
+static VkExtent3D get_level_extent(VkExtent3D extent, u32 level) {
+    return { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), 1 };
+}
+
+// Full mip chain down to 1x1, files claiming more levels are broken
+static u32 get_max_level_count(VkExtent3D extent) {
+    return (u32)std::bit_width(std::max(extent.width, extent.height));
+}
+
+// DDS layout, see the DDS_HEADER and DDS_HEADER_DXT10 docs
+struct dds_pixel_format {
+    u32 size;
+    u32 flags;
+    u32 four_cc;
+    u32 rgb_bit_count;
+    u32 r_mask;
+    u32 g_mask;
+    u32 b_mask;
+    u32 a_mask;
+};
+
+struct dds_header {
+    u32 size;
+    u32 flags;
+    u32 height;
+    u32 width;
+    u32 pitch_or_linear_size;
+    u32 depth;
+    u32 mip_map_count;
+    u32 reserved1[11];
+    dds_pixel_format pixel_format;
+    u32 caps;
+    u32 caps2;
+    u32 caps3;
+    u32 caps4;
+    u32 reserved2;
+};
+
+struct dds_header_dx10 {
+    u32 dxgi_format;
+    u32 resource_dimension;
+    u32 misc_flag;
+    u32 array_size;
+    u32 misc_flags2;
+};
+
+static_assert(sizeof(dds_header) == 124);
+static_assert(sizeof(dds_header_dx10) == 20);
+
+constexpr u32 DDS_MAGIC = 0x20534444; // "DDS "
+constexpr u32 DDS_PIXEL_FORMAT_FOURCC = 0x4;
+constexpr u32 DDS_PIXEL_FORMAT_RGB = 0x40;
+constexpr u32 DDS_CAPS2_CUBEMAP = 0x200;
+constexpr u32 DDS_CAPS2_VOLUME = 0x200000;
+constexpr u32 DDS_DIMENSION_TEXTURE2D = 3;
+
+static constexpr u32 make_four_cc(const char (&code)[5]) {
+    return (u32)code[0] | ((u32)code[1] << 8) | ((u32)code[2] << 16) | ((u32)code[3] << 24);
+}
+
+static VkFormat dxgi_to_vk_format(u32 dxgi_format) {
+    switch(dxgi_format) {
+        case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+        case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+        case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+        case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+        case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+        case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+        case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+        case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+        case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+        case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+        case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+        case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+        case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+// KTX2 layout, see the KTX 2.0 specification
+struct ktx2_header {
+    u8 identifier[12];
+    u32 vk_format;
+    u32 type_size;
+    u32 pixel_width;
+    u32 pixel_height;
+    u32 pixel_depth;
+    u32 layer_count;
+    u32 face_count;
+    u32 level_count;
+    u32 supercompression_scheme;
+    u32 dfd_byte_offset;
+    u32 dfd_byte_length;
+    u32 kvd_byte_offset;
+    u32 kvd_byte_length;
+    u64 sgd_byte_offset;
+    u64 sgd_byte_length;
+};
+
+struct ktx2_level_index {
+    u64 byte_offset;
+    u64 byte_length;
+    u64 uncompressed_byte_length;
+};
+
+static_assert(sizeof(ktx2_header) == 80);
+
+static constexpr u8 KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+void vk_texture_manager::init(VkDevice device, VkPhysicalDevice gpu, VmaAllocator allocator, vk_uploader* uploader, vk_bindless_heap* heap) {
+    this->device = device;
+    this->gpu = gpu;
+    this->allocator = allocator;
+    this->uploader = uploader;
+    this->heap = heap;
+}
+
+void vk_texture_manager::destroy() {
+    for(auto& [key, sampler] : samplers) {
+        heap->remove_sampler(sampler.index);
+        vkDestroySampler(device, sampler.sampler, nullptr);
+    }
+
+    samplers.clear();
+}
+
+vk_texture vk_texture_manager::load(const std::string& path, const vk_sampler_desc& sampler) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+        LOG_THROW("Failed to open texture " + path);
+    }
+
+    u64 file_size = (u64)file.tellg();
+    file.seekg(0);
+
+    bool is_ktx2 = path.ends_with(".ktx2");
+    texture_source source = is_ktx2 ? parse_ktx2(file, path) : parse_dds(file, path);
+
+    // Checked up front, the staging memory is already queued for upload once we start reading into it
+    for(const texture_level& level : source.levels) {
+        if(level.file_offset + level.size > file_size) {
+            LOG_THROW("Texture " + path + " is truncated");
+        }
+    }
+
+    u32 mip_levels = (u32)source.levels.size();
+    if(source.generate_mips) {
+        mip_levels = get_max_level_count(source.extent);
+    }
+
+    vk_texture texture = create_texture(source.format, source.extent, mip_levels, source.generate_mips, sampler);
+
+    std::vector<u64> staging_offsets;
+    u8* staging = stage_levels(texture, source, staging_offsets);
+
+    for(u32 i = 0; i < source.levels.size(); i++) {
+        file.seekg((std::streamoff)source.levels[i].file_offset);
+        file.read((char*)staging + staging_offsets[i], (std::streamsize)source.levels[i].size);
+    }
+
+    if(!file) {
+        // Nothing recorded uses the image yet, only the copy queued on the uploader
+        uploader->cancel_image(texture.image.image);
+        destroy_texture(texture);
+
+        LOG_THROW("Failed to read texture " + path);
+    }
+
+    return texture;
+}
+
+vk_texture vk_texture_manager::create(const void* pixels, VkExtent2D extent, VkFormat format, bool mipmapped, const vk_sampler_desc& sampler) {
+    texture_block_info block;
+    if(!get_block_info(format, block) || block.size != 1) {
+        LOG_THROW("Textures can only be created from uncompressed pixels, format " + std::string(string_VkFormat(format)));
+    }
+
+    texture_source source{};
+    source.format = format;
+    source.extent = { extent.width, extent.height, 1 };
+    source.generate_mips = mipmapped;
+    source.levels.push_back({ 0, get_level_size(block, source.extent), source.extent });
+
+    u32 mip_levels = mipmapped ? (u32)std::bit_width(std::max(extent.width, extent.height)) : 1;
+    vk_texture texture = create_texture(format, source.extent, mip_levels, mipmapped, sampler);
+
+    std::vector<u64> staging_offsets;
+    u8* staging = stage_levels(texture, source, staging_offsets);
+    memcpy(staging, pixels, source.levels[0].size);
+
+    return texture;
+}
+
+void vk_texture_manager::destroy_texture(const vk_texture& texture) {
+    heap->remove_sampled_image(texture.image_index);
+
+    vkDestroyImageView(device, texture.image.image_view, nullptr);
+    vmaDestroyImage(allocator, texture.image.image, texture.image.allocation);
+}
+
+u32 vk_texture_manager::get_sampler(const vk_sampler_desc& desc) {
+    u32 key = ((u32)desc.filter << 8) | (u32)desc.address_mode;
+
+    auto it = samplers.find(key);
+    if(it != samplers.end()) {
+        return it->second.index;
+    }
+
+    VkSamplerCreateInfo sampler_info = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    sampler_info.pNext = nullptr;
+    sampler_info.magFilter = desc.filter;
+    sampler_info.minFilter = desc.filter;
+    sampler_info.mipmapMode = desc.filter == VK_FILTER_NEAREST ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = desc.address_mode;
+    sampler_info.addressModeV = desc.address_mode;
+    sampler_info.addressModeW = desc.address_mode;
+    sampler_info.minLod = 0.f;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+
+    shared_sampler sampler;
+    VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &sampler.sampler));
+    sampler.index = heap->add_sampler(sampler.sampler);
+
+    samplers[key] = sampler;
+    return sampler.index;
+}
+
+vk_texture_manager::texture_source vk_texture_manager::parse_dds(std::ifstream& file, const std::string& path) {
+    u32 magic = 0;
+    dds_header header{};
+    file.read((char*)&magic, sizeof(magic));
+    file.read((char*)&header, sizeof(header));
+
+    if(!file || magic != DDS_MAGIC || header.size != sizeof(dds_header)) {
+        LOG_THROW("Texture " + path + " is not a DDS file");
+    }
+
+    if(header.caps2 & (DDS_CAPS2_CUBEMAP | DDS_CAPS2_VOLUME)) {
+        LOG_THROW("Texture " + path + ": only 2D DDS textures are supported");
+    }
+
+    texture_source source{};
+    source.extent = { header.width, header.height, 1 };
+    u64 data_offset = sizeof(magic) + sizeof(header);
+
+    const dds_pixel_format& pixel_format = header.pixel_format;
+    if(pixel_format.flags & DDS_PIXEL_FORMAT_FOURCC) {
+        if(pixel_format.four_cc == make_four_cc("DX10")) {
+            dds_header_dx10 dx10{};
+            file.read((char*)&dx10, sizeof(dx10));
+
+            if(!file || dx10.resource_dimension != DDS_DIMENSION_TEXTURE2D || dx10.array_size > 1) {
+                LOG_THROW("Texture " + path + ": only 2D DDS textures are supported");
+            }
+
+            source.format = dxgi_to_vk_format(dx10.dxgi_format);
+            data_offset += sizeof(dx10);
+        } else if(pixel_format.four_cc == make_four_cc("DXT1")) {
+            source.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        } else if(pixel_format.four_cc == make_four_cc("DXT2") || pixel_format.four_cc == make_four_cc("DXT3")) {
+            source.format = VK_FORMAT_BC2_UNORM_BLOCK;
+        } else if(pixel_format.four_cc == make_four_cc("DXT4") || pixel_format.four_cc == make_four_cc("DXT5")) {
+            source.format = VK_FORMAT_BC3_UNORM_BLOCK;
+        } else if(pixel_format.four_cc == make_four_cc("ATI1") || pixel_format.four_cc == make_four_cc("BC4U")) {
+            source.format = VK_FORMAT_BC4_UNORM_BLOCK;
+        } else if(pixel_format.four_cc == make_four_cc("ATI2") || pixel_format.four_cc == make_four_cc("BC5U")) {
+            source.format = VK_FORMAT_BC5_UNORM_BLOCK;
+        } else {
+            source.format = VK_FORMAT_UNDEFINED;
+        }
+    } else if((pixel_format.flags & DDS_PIXEL_FORMAT_RGB) && pixel_format.rgb_bit_count == 32) {
+        source.format = pixel_format.r_mask == 0x000000FF ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_B8G8R8A8_UNORM;
+    } else {
+        source.format = VK_FORMAT_UNDEFINED;
+    }
+
+    texture_block_info block;
+    if(source.format == VK_FORMAT_UNDEFINED || !get_block_info(source.format, block)) {
+        LOG_THROW("Texture " + path + " has an unsupported DDS format");
+    }
+
+    // Levels follow each other without padding, biggest first
+    u32 level_count = std::max(header.mip_map_count, 1u);
+    if(level_count > get_max_level_count(source.extent)) {
+        LOG_THROW("Texture " + path + " has " + std::to_string(level_count) + " mip levels, more than its extent allows");
+    }
+    for(u32 i = 0; i < level_count; i++) {
+        VkExtent3D level_extent = get_level_extent(source.extent, i);
+        u64 level_size = get_level_size(block, level_extent);
+
+        source.levels.push_back({ data_offset, level_size, level_extent });
+        data_offset += level_size;
+    }
+
+    return source;
+}
+
+vk_texture_manager::texture_source vk_texture_manager::parse_ktx2(std::ifstream& file, const std::string& path) {
+    ktx2_header header{};
+    file.read((char*)&header, sizeof(header));
+
+    if(!file || memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        LOG_THROW("Texture " + path + " is not a KTX2 file");
+    }
+
+    // Basis Universal and zstd payloads would need a transcoder first
+    if(header.supercompression_scheme != 0 || header.vk_format == VK_FORMAT_UNDEFINED) {
+        LOG_THROW("Texture " + path + ": supercompressed KTX2 files are not supported");
+    }
+
+    if(header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1) {
+        LOG_THROW("Texture " + path + ": only 2D KTX2 textures are supported");
+    }
+
+    texture_source source{};
+    source.format = (VkFormat)header.vk_format;
+    source.extent = { header.pixel_width, std::max(header.pixel_height, 1u), 1 };
+
+    texture_block_info block;
+    if(!get_block_info(source.format, block)) {
+        LOG_THROW("Texture " + path + " has an unsupported KTX2 format " + std::string(string_VkFormat(source.format)));
+    }
+
+    // A level count of 0 asks the loader to generate the mips, which only works for formats we can blit
+    u32 level_count = std::max(header.level_count, 1u);
+    source.generate_mips = header.level_count == 0 && supports_generated_mips(source.format);
+
+    if(level_count > get_max_level_count(source.extent)) {
+        LOG_THROW("Texture " + path + " has " + std::to_string(level_count) + " mip levels, more than its extent allows");
+    }
+
+    std::vector<ktx2_level_index> level_index(level_count);
+    file.read((char*)level_index.data(), (std::streamsize)(level_count * sizeof(ktx2_level_index)));
+
+    if(!file) {
+        LOG_THROW("Texture " + path + " is truncated");
+    }
+
+    for(u32 i = 0; i < level_count; i++) {
+        VkExtent3D level_extent = get_level_extent(source.extent, i);
+
+        if(level_index[i].byte_length != get_level_size(block, level_extent)) {
+            LOG_THROW("Texture " + path + ": level " + std::to_string(i) + " has an unexpected size");
+        }
+
+        source.levels.push_back({ level_index[i].byte_offset, level_index[i].byte_length, level_extent });
+    }
+
+    return source;
+}
+
+vk_texture vk_texture_manager::create_texture(VkFormat format, VkExtent3D extent, u32 mip_levels, bool generate_mips, const vk_sampler_desc& sampler) {
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(gpu, format, &format_properties);
+
+    if(!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        LOG_THROW("Textures in format " + std::string(string_VkFormat(format)) + " can't be sampled on this gpu");
+    }
+
+    if(generate_mips && !supports_generated_mips(format)) {
+        LOG_THROW("Mips of format " + std::string(string_VkFormat(format)) + " can't be generated on this gpu");
+    }
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if(generate_mips) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    vk_texture texture{};
+    texture.mip_levels = mip_levels;
+    texture.image.image_format = format;
+    texture.image.image_extent = extent;
+
+    VkImageCreateInfo img_info = vkinit::image_create_info(format, usage, extent);
+    img_info.mipLevels = mip_levels;
+
+    VmaAllocationCreateInfo img_alloc_info = {};
+    img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    img_alloc_info.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VK_CHECK(vmaCreateImage(allocator, &img_info, &img_alloc_info, &texture.image.image, &texture.image.allocation, nullptr));
+
+    VkImageViewCreateInfo view_info = vkinit::imageview_create_info(format, texture.image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    view_info.subresourceRange.levelCount = mip_levels;
+    VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &texture.image.image_view));
+
+    texture.image_index = heap->add_sampled_image(texture.image.image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    texture.sampler_index = get_sampler(sampler);
+
+    return texture;
+}
+
+u8* vk_texture_manager::stage_levels(vk_texture& texture, const texture_source& source, std::vector<u64>& staging_offsets) {
+    std::vector<VkBufferImageCopy> regions;
+    u64 staging_size = 0;
+
+    for(u32 i = 0; i < source.levels.size(); i++) {
+        staging_size = (staging_size + TEXTURE_LEVEL_ALIGNMENT - 1) & ~(TEXTURE_LEVEL_ALIGNMENT - 1);
+        staging_offsets.push_back(staging_size);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = staging_size;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = source.levels[i].extent;
+        regions.push_back(region);
+
+        staging_size += source.levels[i].size;
+    }
+
+    vk_staged_image staged = uploader->stage_image(texture.image.image, source.extent, texture.mip_levels, staging_size, regions,
+                                                   source.generate_mips, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    texture.upload_value = staged.value;
+
+    return (u8*)staged.data;
+}
+
+bool vk_texture_manager::supports_generated_mips(VkFormat format) const {
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(gpu, format, &format_properties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (format_properties.optimalTilingFeatures & required) == required;
+}
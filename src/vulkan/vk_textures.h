@@ -0,0 +1,98 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_TEXTURES_H
+#define VK_TEXTURES_H
+
+#include <fstream>
+#include <unordered_map>
+
+#include "vk_descriptors.h"
+#include "vk_uploader.h"
+
+struct vk_texture {
+    vk_allocated_image image;
+    u32 mip_levels;
+    u32 image_index; // Bindless sampled image
+    u32 sampler_index; // Bindless sampler
+    u64 upload_value; // Uploader timeline value the texels are in place at
+};
+
+// Samplers are shared by every texture asking for the same state
+struct vk_sampler_desc {
+    VkFilter filter = VK_FILTER_LINEAR;
+    VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+};
+
+// Creates sampled textures and registers them in the bindless heap. KTX2 and DDS files with block compressed payloads
+// are read straight into staging memory with the mips they ship with, uncompressed textures can get their mips generated on the gpu
+class vk_texture_manager {
+public:
+    void init(VkDevice device, VkPhysicalDevice gpu, VmaAllocator allocator, vk_uploader* uploader, vk_bindless_heap* heap);
+
+    /**
+     *  @brief Destroys the shared samplers, the textures have to be destroyed already
+     */
+    void destroy();
+
+    /**
+     *  @brief Loads a .ktx2 or .dds file. Throws on files that aren't a single 2D image in a supported format,
+     *  supercompressed KTX2 files included. A KTX2 file without levels gets its mips generated if the format allows linear blits
+     */
+    vk_texture load(const std::string& path, const vk_sampler_desc& sampler = {});
+
+    /**
+     *  @brief Creates a texture from tightly packed pixels of an uncompressed format, mipmapped ones get their full mip chain blitted on the gpu
+     */
+    vk_texture create(const void* pixels, VkExtent2D extent, VkFormat format, bool mipmapped, const vk_sampler_desc& sampler = {});
+
+    /**
+     *  @brief Frees a texture right away, the gpu has to be done with it
+     */
+    void destroy_texture(const vk_texture& texture);
+
+    /**
+     *  @brief Returns the bindless index of a sampler with the given state, creating it on first use
+     */
+    u32 get_sampler(const vk_sampler_desc& desc);
+
+private:
+    // Where a level sits in the source and in the staging memory
+    struct texture_level {
+        u64 file_offset;
+        u64 size;
+        VkExtent3D extent;
+    };
+
+    struct texture_source {
+        VkFormat format;
+        VkExtent3D extent;
+        bool generate_mips;
+        std::vector<texture_level> levels;
+    };
+
+    texture_source parse_dds(std::ifstream& file, const std::string& path);
+    texture_source parse_ktx2(std::ifstream& file, const std::string& path);
+
+    vk_texture create_texture(VkFormat format, VkExtent3D extent, u32 mip_levels, bool generate_mips, const vk_sampler_desc& sampler);
+
+    // Queues the upload and returns staging memory the levels get written into, level by level at 16 byte aligned offsets
+    u8* stage_levels(vk_texture& texture, const texture_source& source, std::vector<u64>& staging_offsets);
+
+    bool supports_generated_mips(VkFormat format) const;
+
+    VkDevice device;
+    VkPhysicalDevice gpu;
+    VmaAllocator allocator;
+    vk_uploader* uploader;
+    vk_bindless_heap* heap;
+
+    struct shared_sampler {
+        VkSampler sampler;
+        u32 index;
+    };
+    std::unordered_map<u32, shared_sampler> samplers; // Keyed by filter and address mode
+};
+
+#endif //VK_TEXTURES_H
@@ -0,0 +1,179 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_transient_allocator.h"
+
+#include <algorithm>
+
+#include "vk_initializers.h"
+
+void vk_transient_allocator::init(VkDevice device, VmaAllocator allocator, vk_bindless_heap* heap) {
+    this->device = device;
+    this->allocator = allocator;
+    this->heap = heap;
+
+    current = {};
+}
+
+void vk_transient_allocator::destroy() {
+    destroy_placement(current);
+    current = {};
+}
+
+std::span<const vk_transient_image> vk_transient_allocator::allocate(std::span<const vk_transient_request> requests,
+                                                                     const std::function<void(std::function<void()>&&)>& retire) {
+    if(matches(requests)) {
+        return current.images;
+    }
+
+    if(!current.images.empty()) {
+        retire([this, old = std::move(current)]() {
+            destroy_placement(old);
+        });
+    }
+
+    current = build(requests);
+    return current.images;
+}
+
+bool vk_transient_allocator::matches(std::span<const vk_transient_request> requests) const {
+    if(requests.size() != current.requests.size()) return false;
+
+    for(u32 i = 0; i < requests.size(); i++) {
+        const vk_transient_request& a = requests[i];
+        const vk_transient_request& b = current.requests[i];
+
+        if(a.first_pass != b.first_pass || a.last_pass != b.last_pass || a.desc.format != b.desc.format || a.desc.usage != b.desc.usage
+           || a.desc.aspect != b.desc.aspect || a.desc.sampled_layout != b.desc.sampled_layout || a.desc.extent.width != b.desc.extent.width
+           || a.desc.extent.height != b.desc.extent.height || a.desc.extent.depth != b.desc.extent.depth) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+vk_transient_allocator::placement vk_transient_allocator::build(std::span<const vk_transient_request> requests) {
+    placement result{};
+    result.requests.assign(requests.begin(), requests.end());
+    result.images.resize(requests.size());
+
+    std::vector<VkMemoryRequirements> memory_requirements(requests.size());
+
+    for(u32 i = 0; i < requests.size(); i++) {
+        const vk_transient_image_desc& desc = requests[i].desc;
+
+        // Created without memory, it gets bound to an offset in a shared block below
+        VkImageCreateInfo img_info = vkinit::image_create_info(desc.format, desc.usage, desc.extent);
+        VK_CHECK(vkCreateImage(device, &img_info, nullptr, &result.images[i].image));
+
+        vkGetImageMemoryRequirements(device, result.images[i].image, &memory_requirements[i]);
+        result.requested_bytes += memory_requirements[i].size;
+    }
+
+    // Images that can live in the same memory types share a block, in practice color and depth attachments all end up in one
+    std::vector<u32> block_memory_types;
+    std::vector<u32> image_order(requests.size());
+    for(u32 i = 0; i < requests.size(); i++) {
+        image_order[i] = i;
+
+        auto block = std::find(block_memory_types.begin(), block_memory_types.end(), memory_requirements[i].memoryTypeBits);
+        result.images[i].memory_block = (u32)(block - block_memory_types.begin());
+
+        if(block == block_memory_types.end()) {
+            block_memory_types.push_back(memory_requirements[i].memoryTypeBits);
+        }
+    }
+
+    // Biggest first, smaller images then fill the gaps next to them
+    std::sort(image_order.begin(), image_order.end(), [&](u32 a, u32 b) {
+        return memory_requirements[a].size > memory_requirements[b].size;
+    });
+
+    std::vector<VkDeviceSize> offsets(requests.size(), 0);
+    std::vector<VkDeviceSize> block_sizes(block_memory_types.size(), 0);
+    std::vector<VkDeviceSize> block_alignments(block_memory_types.size(), 1);
+    std::vector<u32> placed;
+
+    for(u32 image : image_order) {
+        const VkMemoryRequirements& reqs = memory_requirements[image];
+        u32 block = result.images[image].memory_block;
+
+        // Only images used at the same time as this one are in the way
+        std::vector<u32> conflicts;
+        for(u32 other : placed) {
+            if(result.images[other].memory_block != block) continue;
+
+            bool overlaps = requests[image].first_pass <= requests[other].last_pass && requests[other].first_pass <= requests[image].last_pass;
+            if(overlaps) {
+                conflicts.push_back(other);
+            }
+        }
+
+        // The lowest offset that clears every conflict is either 0 or right behind one of them
+        VkDeviceSize best = ~0ull;
+        for(u32 candidate = 0; candidate <= conflicts.size(); candidate++) {
+            VkDeviceSize offset = candidate == conflicts.size() ? 0 : offsets[conflicts[candidate]] + memory_requirements[conflicts[candidate]].size;
+            offset = (offset + reqs.alignment - 1) / reqs.alignment * reqs.alignment;
+
+            bool fits = true;
+            for(u32 other : conflicts) {
+                if(offset < offsets[other] + memory_requirements[other].size && offsets[other] < offset + reqs.size) {
+                    fits = false;
+                    break;
+                }
+            }
+
+            if(fits) {
+                best = std::min(best, offset);
+            }
+        }
+
+        offsets[image] = best;
+        block_sizes[block] = std::max(block_sizes[block], best + reqs.size);
+        block_alignments[block] = std::max(block_alignments[block], reqs.alignment);
+        placed.push_back(image);
+    }
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    result.blocks.resize(block_memory_types.size());
+    for(u32 block = 0; block < block_memory_types.size(); block++) {
+        VkMemoryRequirements block_reqs{ block_sizes[block], block_alignments[block], block_memory_types[block] };
+        VK_CHECK(vmaAllocateMemory(allocator, &block_reqs, &alloc_info, &result.blocks[block], nullptr));
+
+        result.allocated_bytes += block_sizes[block];
+    }
+
+    for(u32 i = 0; i < requests.size(); i++) {
+        const vk_transient_image_desc& desc = requests[i].desc;
+        vk_transient_image& image = result.images[i];
+
+        VK_CHECK(vmaBindImageMemory2(allocator, result.blocks[image.memory_block], offsets[i], image.image, nullptr));
+
+        VkImageViewCreateInfo view_info = vkinit::imageview_create_info(desc.format, image.image, desc.aspect);
+        VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &image.view));
+
+        image.sampled_index = desc.sampled_layout != VK_IMAGE_LAYOUT_UNDEFINED ? heap->add_sampled_image(image.view, desc.sampled_layout) : 0;
+    }
+
+    return result;
+}
+
+void vk_transient_allocator::destroy_placement(const placement& old) {
+    for(u32 i = 0; i < old.images.size(); i++) {
+        if(old.requests[i].desc.sampled_layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+            heap->remove_sampled_image(old.images[i].sampled_index);
+        }
+
+        vkDestroyImageView(device, old.images[i].view, nullptr);
+        vkDestroyImage(device, old.images[i].image, nullptr);
+    }
+
+    for(VmaAllocation block : old.blocks) {
+        vmaFreeMemory(allocator, block);
+    }
+}
@@ -0,0 +1,81 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_TRANSIENT_ALLOCATOR_H
+#define VK_TRANSIENT_ALLOCATOR_H
+
+#include "vk_descriptors.h"
+#include "vk_types.h"
+
+struct vk_transient_image_desc {
+    VkFormat format;
+    VkExtent3D extent;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+    VkImageLayout sampled_layout = VK_IMAGE_LAYOUT_UNDEFINED; // Layout it is sampled in through the bindless heap, UNDEFINED keeps it out of the heap
+};
+
+struct vk_transient_image {
+    VkImage image;
+    VkImageView view;
+    u32 sampled_index; // Bindless sampled image, only when the desc has a sampled_layout
+    u32 memory_block; // Images of one block may share memory
+};
+
+// An image that is only needed between two passes of a frame
+struct vk_transient_request {
+    vk_transient_image_desc desc;
+    u32 first_pass;
+    u32 last_pass;
+};
+
+// Places the transient images of a frame into as little memory as possible. Images whose pass ranges don't overlap get bound
+// to the same memory, so their contents don't survive the frame. The placement is kept for as long as the frames ask for the same images
+class vk_transient_allocator {
+public:
+    void init(VkDevice device, VmaAllocator allocator, vk_bindless_heap* heap);
+
+    /**
+     *  @brief Frees the current images right away, the gpu has to be done with them
+     */
+    void destroy();
+
+    /**
+     *  @brief Returns an image per request, in request order. A frame with the same requests as the last one gets the same images,
+     *  otherwise the old ones are handed to retire and freed once the frames in flight are done with them
+     */
+    std::span<const vk_transient_image> allocate(std::span<const vk_transient_request> requests, const std::function<void(std::function<void()>&&)>& retire);
+
+    /**
+     *  @brief Memory the images would take without aliasing
+     */
+    VkDeviceSize get_requested_bytes() const { return current.requested_bytes; }
+
+    /**
+     *  @brief Memory actually allocated for them
+     */
+    VkDeviceSize get_allocated_bytes() const { return current.allocated_bytes; }
+
+private:
+    struct placement {
+        std::vector<vk_transient_request> requests;
+        std::vector<vk_transient_image> images;
+        std::vector<VmaAllocation> blocks; // One per memory type the images need
+        VkDeviceSize requested_bytes = 0;
+        VkDeviceSize allocated_bytes = 0;
+    };
+
+    bool matches(std::span<const vk_transient_request> requests) const;
+
+    placement build(std::span<const vk_transient_request> requests);
+    void destroy_placement(const placement& old);
+
+    VkDevice device;
+    VmaAllocator allocator;
+    vk_bindless_heap* heap;
+
+    placement current;
+};
+
+#endif //VK_TRANSIENT_ALLOCATOR_H
@@ -21,6 +21,7 @@
 #include <vk_mem_alloc.h>
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
 #include "defines.h"
@@ -46,4 +47,41 @@ struct vk_allocated_image {
     VkFormat image_format;
 };
 
+struct vk_allocated_buffer {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    VmaAllocationInfo info;
+};
+
+// Layout matches the Vertex struct in the shaders, uvs are interleaved to keep it 16 byte aligned
+struct vk_vertex {
+    glm::vec3 position;
+    f32 uv_x;
+    glm::vec3 normal;
+    f32 uv_y;
+    glm::vec4 color;
+};
+
+// Vertices are pulled in the vertex shader through vertex_buffer_address, so no vertex input state is needed
+struct vk_gpu_mesh_buffers {
+    vk_allocated_buffer index_buffer;
+    vk_allocated_buffer vertex_buffer;
+    VkDeviceAddress vertex_buffer_address;
+    u32 index_count;
+    u32 mesh_id; // Unique per mesh, the render queue batches instances of the same mesh by it
+};
+
+// Per instance data the mesh vertex shader reads through gl_InstanceIndex
+struct vk_gpu_instance_data {
+    glm::mat4 world_matrix;
+};
+
+struct vk_gpu_draw_push_constants {
+    VkDeviceAddress vertex_buffer;
+    VkDeviceAddress instance_buffer;
+    VkDeviceAddress virtual_textures; // VirtualTextureSystem of the frame, see virtual_texture.glsl
+    u32 virtual_texture; // Id virtual_texture_mesh.frag samples
+    u32 padding;
+};
+
 #endif //VK_TYPES_H
@@ -0,0 +1,345 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_uploader.h"
+
+#include <cstring>
+
+#include "vk_images.h"
+#include "vk_initializers.h"
+
+// Copies into images need the source offset to be a multiple of the texel size, 16 covers every format we use
+constexpr VkDeviceSize UPLOAD_ALIGNMENT = 16;
+
+void vk_uploader::init(VkDevice device, VmaAllocator allocator, VkQueue queue, u32 queue_family, VkDeviceSize staging_size) {
+    this->device = device;
+    this->allocator = allocator;
+    this->queue = queue;
+
+    timeline.init(device);
+
+    VkCommandPoolCreateInfo pool_info = vkinit::command_pool_create_info(queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &command_pool));
+
+    // The ring stays mapped for its whole lifetime, uploads only memcpy into it
+    VkBufferCreateInfo buffer_info = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.pNext = nullptr;
+    buffer_info.size = staging_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &ring.buffer, &ring.allocation, &ring.info));
+
+    ring_size = staging_size;
+    head = 0;
+    tail = 0;
+    pending_start = 0;
+}
+
+void vk_uploader::destroy() {
+    VK_CHECK(timeline.wait(device, timeline.submitted_value, UINT64_MAX));
+
+    deletion_queue.flush();
+
+    for(auto& buffer : pending_dedicated) {
+        vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+    }
+
+    vmaDestroyBuffer(allocator, ring.buffer, ring.allocation);
+    vkDestroyCommandPool(device, command_pool, nullptr);
+    timeline.destroy(device);
+}
+
+void vk_uploader::set_ownership_transfer(u32 src_family, u32 dst_family) {
+    if(src_family == dst_family) {
+        src_family = VK_QUEUE_FAMILY_IGNORED;
+        dst_family = VK_QUEUE_FAMILY_IGNORED;
+    }
+
+    release_src_family = src_family;
+    release_dst_family = dst_family;
+}
+
+u64 vk_uploader::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size) {
+    staging_allocation staging = allocate(size, UPLOAD_ALIGNMENT);
+    memcpy(staging.mapped, data, size);
+
+    VkBufferCopy region{};
+    region.srcOffset = staging.offset;
+    region.dstOffset = dst_offset;
+    region.size = size;
+
+    pending_buffer_copies.push_back({ staging.buffer, dst, region });
+
+    return timeline.next_value();
+}
+
+u64 vk_uploader::upload_image(const vk_allocated_image& dst, const void* data, VkDeviceSize size, VkImageLayout final_layout) {
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = dst.image_extent;
+
+    vk_staged_image staged = stage_image(dst.image, dst.image_extent, 1, size, { &region, 1 }, false, final_layout);
+    memcpy(staged.data, data, size);
+
+    return staged.value;
+}
+
+vk_staged_image vk_uploader::stage_image(VkImage dst, VkExtent3D extent, u32 mip_levels, VkDeviceSize size, std::span<const VkBufferImageCopy> regions,
+                                         bool generate_mips, VkImageLayout final_layout, VkImageLayout current_layout) {
+    // The acquire on the other queue expects the image straight out of the copy
+    if(generate_mips && release_dst_family != VK_QUEUE_FAMILY_IGNORED) {
+        LOG_THROW("Uploader: mips can only be generated on the queue that uses the image");
+    }
+
+    staging_allocation staging = allocate(size, UPLOAD_ALIGNMENT);
+
+    pending_image_copies.push_back({ staging.buffer, dst, extent, mip_levels, generate_mips && mip_levels > 1, current_layout, final_layout,
+                                     (u32)pending_image_regions.size(), (u32)regions.size() });
+
+    for(VkBufferImageCopy region : regions) {
+        region.bufferOffset += staging.offset;
+        pending_image_regions.push_back(region);
+    }
+
+    return { staging.mapped, timeline.next_value() };
+}
+
+void vk_uploader::cancel_image(VkImage dst) {
+    std::erase_if(pending_image_copies, [dst](const image_copy& copy) { return copy.dst == dst; });
+}
+
+u64 vk_uploader::flush() {
+    if(pending_buffer_copies.empty() && pending_image_copies.empty()) {
+        return timeline.submitted_value;
+    }
+
+    VkCommandBuffer cmd = get_command_buffer();
+
+    VkCommandBufferBeginInfo begin_info = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+    bool release = release_dst_family != VK_QUEUE_FAMILY_IGNORED;
+
+    // Copies can overwrite parts of buffers that earlier submissions on the queue are still reading, like the gpu scene's objects
+    VkMemoryBarrier2 read_barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    read_barrier.pNext = nullptr;
+    read_barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    read_barrier.srcAccessMask = VK_ACCESS_2_NONE;
+    read_barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    read_barrier.dstAccessMask = VK_ACCESS_2_NONE;
+
+    VkDependencyInfo read_dep_info = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    read_dep_info.pNext = nullptr;
+    read_dep_info.memoryBarrierCount = 1;
+    read_dep_info.pMemoryBarriers = &read_barrier;
+
+    vkCmdPipelineBarrier2(cmd, &read_dep_info);
+
+    for(const buffer_copy& copy : pending_buffer_copies) {
+        vkCmdCopyBuffer(cmd, copy.src, copy.dst, 1, &copy.region);
+    }
+
+    std::vector<VkBufferMemoryBarrier2> buffer_releases;
+    std::vector<VkImageMemoryBarrier2> image_releases;
+
+    for(const image_copy& copy : pending_image_copies) {
+        vkutil::transition_image(cmd, copy.dst, copy.current_layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        vkCmdCopyBufferToImage(cmd, copy.src, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.region_count, &pending_image_regions[copy.first_region]);
+
+        if(copy.generate_mips) {
+            // Leaves every level as a transfer source
+            vkutil::generate_mipmaps(cmd, copy.dst, { copy.extent.width, copy.extent.height }, copy.mip_levels);
+            vkutil::transition_image(cmd, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.final_layout);
+        } else if(release) {
+            // The layout transition is part of the ownership transfer, the acquire has to repeat it
+            image_releases.push_back(vkutil::image_ownership_barrier(copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.final_layout,
+                                                                     release_src_family, release_dst_family, true));
+        } else {
+            vkutil::transition_image(cmd, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.final_layout);
+        }
+    }
+
+    if(release) {
+        for(const buffer_copy& copy : pending_buffer_copies) {
+            buffer_releases.push_back(vkutil::buffer_ownership_barrier(copy.dst, copy.region.dstOffset, copy.region.size,
+                                                                       release_src_family, release_dst_family, true));
+        }
+    }
+
+    // Later submissions on the queue are ordered after this one, the barrier makes the copies visible to them.
+    // With an ownership transfer the release barriers take care of that instead
+    VkMemoryBarrier2 barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    barrier.pNext = nullptr;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+
+    VkDependencyInfo dep_info = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dep_info.pNext = nullptr;
+
+    if(release) {
+        dep_info.bufferMemoryBarrierCount = (u32)buffer_releases.size();
+        dep_info.pBufferMemoryBarriers = buffer_releases.data();
+        dep_info.imageMemoryBarrierCount = (u32)image_releases.size();
+        dep_info.pImageMemoryBarriers = image_releases.data();
+    } else {
+        dep_info.memoryBarrierCount = 1;
+        dep_info.pMemoryBarriers = &barrier;
+    }
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    u64 value = timeline.advance();
+
+    VkCommandBufferSubmitInfo cmd_info = vkinit::command_buffer_submit_info(cmd);
+    VkSemaphoreSubmitInfo signal_info = timeline.submit_info(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, value);
+    VkSubmitInfo2 submit = vkinit::submit_info(&cmd_info, &signal_info, nullptr);
+
+    VK_CHECK(vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE));
+
+    command_buffers.back().value = value;
+
+    // The batch keeps its part of the ring until the gpu reached its value
+    if(pending_start != head) {
+        regions.push_back({ head, value });
+        pending_start = head;
+    }
+
+    for(auto& buffer : pending_dedicated) {
+        deletion_queue.push_function(value, [=, this]() {
+            vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+        });
+    }
+
+    pending_buffer_copies.clear();
+    pending_image_copies.clear();
+    pending_image_regions.clear();
+    pending_dedicated.clear();
+
+    return value;
+}
+
+void vk_uploader::collect() {
+    u64 completed = timeline.get_completed_value(device);
+
+    while(!regions.empty() && regions.front().value <= completed) {
+        tail = regions.front().end;
+        regions.pop_front();
+    }
+
+    // Nothing in use, start over from the beginning so big uploads don't have to wrap
+    if(regions.empty() && pending_start == head) {
+        head = 0;
+        tail = 0;
+        pending_start = 0;
+    }
+
+    deletion_queue.collect(completed);
+}
+
+vk_uploader::staging_allocation vk_uploader::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    if(size > ring_size) {
+        VkBufferCreateInfo buffer_info = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+        buffer_info.pNext = nullptr;
+        buffer_info.size = size;
+        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+        VmaAllocationCreateInfo alloc_info = {};
+        alloc_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+        alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        vk_allocated_buffer buffer;
+        VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer.buffer, &buffer.allocation, &buffer.info));
+
+        pending_dedicated.push_back(buffer);
+
+        return { buffer.buffer, 0, buffer.info.pMappedData };
+    }
+
+    VkDeviceSize offset;
+    while(!try_allocate_ring(size, alignment, offset)) {
+        // The ring is full. Submit what is queued so far, then wait for the oldest batch to free its memory
+        flush();
+
+        VK_CHECK(timeline.wait(device, regions.front().value, UINT64_MAX));
+        collect();
+    }
+
+    return { ring.buffer, offset, (char*)ring.info.pMappedData + offset };
+}
+
+bool vk_uploader::try_allocate_ring(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    bool empty = regions.empty() && pending_start == head;
+    if(empty) {
+        head = 0;
+        tail = 0;
+        pending_start = 0;
+    }
+
+    // head == tail with something in flight means every byte is taken
+    if(!empty && head == tail) {
+        return false;
+    }
+
+    VkDeviceSize aligned = (head + alignment - 1) & ~(alignment - 1);
+
+    if(head >= tail) {
+        if(aligned + size <= ring_size) {
+            offset = aligned;
+            head = aligned + size;
+            return true;
+        }
+
+        // Wrap around, the end of the ring stays unused until the tail passes it
+        if(size <= tail) {
+            offset = 0;
+            head = size;
+            return true;
+        }
+
+        return false;
+    }
+
+    if(aligned + size <= tail) {
+        offset = aligned;
+        head = aligned + size;
+        return true;
+    }
+
+    return false;
+}
+
+VkCommandBuffer vk_uploader::get_command_buffer() {
+    u64 completed = timeline.get_completed_value(device);
+
+    // Keep the command buffer we return at the back, flush stamps it with the batch value
+    for(size_t i = 0; i < command_buffers.size(); i++) {
+        if(command_buffers[i].value <= completed) {
+            std::swap(command_buffers[i], command_buffers.back());
+
+            VK_CHECK(vkResetCommandBuffer(command_buffers.back().cmd, 0));
+            return command_buffers.back().cmd;
+        }
+    }
+
+    VkCommandBufferAllocateInfo cmd_info = vkinit::command_buffer_allocate_info(command_pool, 1);
+
+    batch_command_buffer new_buffer{};
+    VK_CHECK(vkAllocateCommandBuffers(device, &cmd_info, &new_buffer.cmd));
+
+    command_buffers.push_back(new_buffer);
+    return new_buffer.cmd;
+}
@@ -0,0 +1,141 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_UPLOADER_H
+#define VK_UPLOADER_H
+
+#include "vk_sync.h"
+#include "vk_types.h"
+
+// Staging memory handed out by stage_image, valid until the next flush
+struct vk_staged_image {
+    void* data;
+    u64 value; // Upload timeline value the copy completes at
+};
+
+// Batches buffer and image uploads through a persistently mapped staging ring.
+// Everything queued between two flushes is recorded into a single submission, which signals the upload timeline.
+// Uploads return the timeline value they complete at, the data is only read once a later submission on the same queue runs
+class vk_uploader {
+public:
+    void init(VkDevice device, VmaAllocator allocator, VkQueue queue, u32 queue_family, VkDeviceSize staging_size);
+
+    /**
+     *  @brief Waits for every submitted batch and frees the staging memory
+     */
+    void destroy();
+
+    /**
+     *  @brief Hands the uploaded resources from src_family to dst_family at the end of every batch instead of only making the writes visible.
+     *  The other queue has to record the matching acquire, see vkutil::buffer_ownership_barrier and vkutil::image_ownership_barrier
+     */
+    void set_ownership_transfer(u32 src_family, u32 dst_family);
+
+    /**
+     *  @brief Queues a copy of size bytes into the buffer, returns the upload timeline value it completes at
+     */
+    u64 upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+
+    /**
+     *  @brief Queues a copy of tightly packed texel data into mip 0 of the image, leaving it in final_layout
+     */
+    u64 upload_image(const vk_allocated_image& dst, const void* data, VkDeviceSize size, VkImageLayout final_layout);
+
+    /**
+     *  @brief Queues a copy into the image and returns size bytes of staging memory to write the texel data into before the next flush,
+     *  so files can be read straight into it. The regions' buffer offsets are relative to that memory and have to be multiples of 16.
+     *  With generate_mips the regions only fill mip 0 and the other levels are blitted down from it, which needs a graphics queue and a format that supports linear blits.
+     *  current_layout other than UNDEFINED keeps what the regions don't cover, for images that get updated piece by piece
+     */
+    vk_staged_image stage_image(VkImage dst, VkExtent3D extent, u32 mip_levels, VkDeviceSize size, std::span<const VkBufferImageCopy> regions,
+                                bool generate_mips, VkImageLayout final_layout, VkImageLayout current_layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+    /**
+     *  @brief Drops the copies into the image queued since the last flush, so it can be destroyed before the flush.
+     *  Their staging memory is released with the rest of the batch
+     */
+    void cancel_image(VkImage dst);
+
+    /**
+     *  @brief Submits everything queued since the last flush, returns the timeline value of the batch
+     */
+    u64 flush();
+
+    /**
+     *  @brief Releases the staging memory of the batches the gpu has finished
+     */
+    void collect();
+
+    bool is_complete(u64 value) const { return timeline.is_complete(device, value); }
+    VkResult wait(u64 value, u64 timeout) const { return timeline.wait(device, value, timeout); }
+
+    const vk_timeline& get_timeline() const { return timeline; }
+
+private:
+    struct staging_allocation {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        void* mapped;
+    };
+
+    struct buffer_copy {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+
+    struct image_copy {
+        VkBuffer src;
+        VkImage dst;
+        VkExtent3D extent;
+        u32 mip_levels;
+        bool generate_mips;
+        VkImageLayout current_layout;
+        VkImageLayout final_layout;
+        u32 first_region; // Into pending_image_regions, offsets already point into src
+        u32 region_count;
+    };
+
+    struct ring_region {
+        VkDeviceSize end; // Ring offset the batch's allocations end at
+        u64 value; // Upload timeline value of the batch
+    };
+
+    struct batch_command_buffer {
+        VkCommandBuffer cmd;
+        u64 value;
+    };
+
+    staging_allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+    bool try_allocate_ring(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    VkCommandBuffer get_command_buffer();
+
+    VkDevice device;
+    VmaAllocator allocator;
+    VkQueue queue;
+
+    // Queue families of the ownership transfer, both VK_QUEUE_FAMILY_IGNORED when the resources stay on the uploading queue
+    u32 release_src_family = VK_QUEUE_FAMILY_IGNORED;
+    u32 release_dst_family = VK_QUEUE_FAMILY_IGNORED;
+
+    vk_timeline timeline;
+    VkCommandPool command_pool;
+    std::vector<batch_command_buffer> command_buffers;
+
+    vk_allocated_buffer ring;
+    VkDeviceSize ring_size;
+    VkDeviceSize head; // Next free offset
+    VkDeviceSize tail; // Start of the oldest region still in use
+    VkDeviceSize pending_start; // Start of the batch that hasn't been submitted yet
+    std::deque<ring_region> regions; // Submitted batches still holding ring memory, oldest first
+
+    std::vector<buffer_copy> pending_buffer_copies;
+    std::vector<image_copy> pending_image_copies;
+    std::vector<VkBufferImageCopy> pending_image_regions;
+    std::vector<vk_allocated_buffer> pending_dedicated; // Uploads bigger than the whole ring get their own staging buffer
+
+    timeline_deletion_queue deletion_queue;
+};
+
+#endif //VK_UPLOADER_H
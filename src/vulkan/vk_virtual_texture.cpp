@@ -0,0 +1,631 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#include "vk_virtual_texture.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include "vk_initializers.h"
+
+constexpr u32 VIRTUAL_TEXTURE_MAGIC = 0x58455456; // "VTEX"
+constexpr u32 INVALID_SLOT = ~0u;
+constexpr u32 INVALID_PAGE = ~0u;
+
+// Page ids, also what the shaders write as feedback: texture in bits 24-31, mip in 20-23, y in 10-19, x in 0-9
+static u32 make_page_id(u32 texture, u32 mip, u32 x, u32 y) {
+    return (texture << 24) | (mip << 20) | (y << 10) | x;
+}
+
+static void decode_page_id(u32 page_id, u32& texture, u32& mip, u32& x, u32& y) {
+    texture = page_id >> 24;
+    mip = (page_id >> 20) & 0xF;
+    y = (page_id >> 10) & 0x3FF;
+    x = page_id & 0x3FF;
+}
+
+// Page table entries: slot x in bits 0-11, slot y in 12-23, the mip the slot holds in 24-27, bit 31 once anything is resident
+constexpr u32 PAGE_TABLE_VALID = 1u << 31;
+
+static u32 make_page_table_entry(u32 slot, u32 pages_per_side, u32 mip) {
+    return PAGE_TABLE_VALID | (mip << 24) | ((slot / pages_per_side) << 12) | (slot % pages_per_side);
+}
+
+void vk_virtual_texture_cache::init(VkDevice device, VmaAllocator allocator, vk_uploader* uploader, vk_bindless_heap* heap, u32 frame_count,
+                                    const vk_virtual_texture_cache_desc& desc) {
+    this->device = device;
+    this->allocator = allocator;
+    this->uploader = uploader;
+    this->heap = heap;
+    this->desc = desc;
+
+    // Pages get copied as raw 4 byte texels, which keeps every page a multiple of the upload alignment
+    if(desc.format != VK_FORMAT_R8G8B8A8_UNORM && desc.format != VK_FORMAT_R8G8B8A8_SRGB
+       && desc.format != VK_FORMAT_B8G8R8A8_UNORM && desc.format != VK_FORMAT_B8G8R8A8_SRGB) {
+        LOG_THROW("Virtual texture cache: format " + std::string(string_VkFormat(desc.format)) + " is not supported");
+    }
+
+    if(!std::has_single_bit(desc.page_size) || desc.pages_per_side == 0 || desc.pages_per_side > 4096) {
+        LOG_THROW("Virtual texture cache: page_size has to be a power of two and pages_per_side at most 4096");
+    }
+
+    slot_size = desc.page_size + 2 * desc.page_border;
+    u32 atlas_size = slot_size * desc.pages_per_side;
+
+    VkImageCreateInfo img_info = vkinit::image_create_info(desc.format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, {atlas_size, atlas_size, 1});
+
+    VmaAllocationCreateInfo img_alloc_info = {};
+    img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    img_alloc_info.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VK_CHECK(vmaCreateImage(allocator, &img_info, &img_alloc_info, &atlas, &atlas_allocation, nullptr));
+
+    VkImageViewCreateInfo view_info = vkinit::imageview_create_info(desc.format, atlas, VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &atlas_view));
+
+    atlas_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    atlas_index = heap->add_sampled_image(atlas_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    VkSamplerCreateInfo sampler_info = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    sampler_info.pNext = nullptr;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.minLod = 0.f;
+    sampler_info.maxLod = 0.f;
+
+    VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &sampler));
+    sampler_index = heap->add_sampler(sampler);
+
+    slots.resize(desc.pages_per_side * desc.pages_per_side);
+    for(u32 i = 0; i < slots.size(); i++) {
+        slots[i] = { INVALID_PAGE, 0, false, {} };
+    }
+
+    // Popped from the back, so the atlas fills up from slot 0
+    free_slots.resize(slots.size());
+    for(u32 i = 0; i < free_slots.size(); i++) {
+        free_slots[i] = (u32)free_slots.size() - 1 - i;
+    }
+
+    frames.resize(frame_count);
+    for(auto& frame : frames) {
+        // Read back by the cpu, host cached memory keeps that fast
+        frame.feedback_buffer = create_buffer(sizeof(vk_gpu_virtual_texture_feedback) + desc.feedback_capacity * sizeof(u32),
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, &frame.feedback_buffer_address);
+
+        auto& feedback = *(vk_gpu_virtual_texture_feedback*)frame.feedback_buffer.info.pMappedData;
+        feedback.count = 0;
+        feedback.capacity = desc.feedback_capacity;
+        VK_CHECK(vmaFlushAllocation(allocator, frame.feedback_buffer.allocation, 0, VK_WHOLE_SIZE));
+
+        frame.system_buffer = create_buffer(sizeof(vk_gpu_virtual_texture_system) + VIRTUAL_TEXTURE_MAX_TEXTURES * sizeof(vk_gpu_virtual_texture),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &frame.system_buffer_address);
+        write_system(frame);
+    }
+
+    stopping = false;
+    loader = std::thread(&vk_virtual_texture_cache::loader_loop, this);
+}
+
+void vk_virtual_texture_cache::destroy() {
+    {
+        std::lock_guard lock(load_mutex);
+        stopping = true;
+    }
+
+    load_cv.notify_one();
+
+    if(loader.joinable()) {
+        loader.join();
+    }
+
+    for(virtual_texture& texture : textures) {
+        heap->remove_sampled_image(texture.page_table_index);
+        vkDestroyImageView(device, texture.page_table_view, nullptr);
+        vmaDestroyImage(allocator, texture.page_table_image, texture.page_table_allocation);
+    }
+
+    for(auto& frame : frames) {
+        vmaDestroyBuffer(allocator, frame.feedback_buffer.buffer, frame.feedback_buffer.allocation);
+        vmaDestroyBuffer(allocator, frame.system_buffer.buffer, frame.system_buffer.allocation);
+    }
+
+    heap->remove_sampler(sampler_index);
+    heap->remove_sampled_image(atlas_index);
+
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyImageView(device, atlas_view, nullptr);
+    vmaDestroyImage(allocator, atlas, atlas_allocation);
+
+    textures.clear();
+    frames.clear();
+}
+
+u32 vk_virtual_texture_cache::load(const std::string& path) {
+    if(textures.size() == VIRTUAL_TEXTURE_MAX_TEXTURES) {
+        LOG_THROW("Virtual texture cache: more than " + std::to_string(VIRTUAL_TEXTURE_MAX_TEXTURES) + " textures");
+    }
+
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+        LOG_THROW("Failed to open virtual texture " + path);
+    }
+
+    u64 file_size = (u64)file.tellg();
+    file.seekg(0);
+
+    vk_virtual_texture_file_header header{};
+    file.read((char*)&header, sizeof(header));
+
+    if(!file || header.magic != VIRTUAL_TEXTURE_MAGIC) {
+        LOG_THROW("Virtual texture " + path + " is not a tiled texture");
+    }
+
+    if(header.format != (u32)desc.format || header.page_size != desc.page_size || header.page_border != desc.page_border) {
+        LOG_THROW("Virtual texture " + path + ": format, page size or border don't match the cache");
+    }
+
+    // Power of two sizes keep the pages of every mip exactly half of the previous one
+    if(!std::has_single_bit(header.width) || !std::has_single_bit(header.height)
+       || std::max(header.width, header.height) / desc.page_size > VIRTUAL_TEXTURE_MAX_PAGES_PER_SIDE) {
+        LOG_THROW("Virtual texture " + path + ": sizes have to be powers of two, at most " + std::to_string(VIRTUAL_TEXTURE_MAX_PAGES_PER_SIDE) + " pages per side");
+    }
+
+    u32 mip_count = (u32)std::bit_width(std::max(std::max(header.width, header.height) / desc.page_size, 1u));
+    if(header.mip_count != mip_count || mip_count > VIRTUAL_TEXTURE_MAX_MIPS) {
+        LOG_THROW("Virtual texture " + path + ": expected " + std::to_string(mip_count) + " mips down to a single page");
+    }
+
+    u32 texture_id = (u32)textures.size();
+    virtual_texture& texture = textures.emplace_back();
+    texture.path = path;
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.mip_count = mip_count;
+
+    u32 page_count = 0;
+    for(u32 mip = 0; mip < mip_count; mip++) {
+        texture.pages_x[mip] = std::max(std::max(header.width >> mip, 1u) / desc.page_size, 1u);
+        texture.pages_y[mip] = std::max(std::max(header.height >> mip, 1u) / desc.page_size, 1u);
+        texture.first_page[mip] = page_count;
+        page_count += texture.pages_x[mip] * texture.pages_y[mip];
+    }
+
+    if(file_size < sizeof(header) + (u64)page_count * get_page_bytes()) {
+        textures.pop_back();
+        LOG_THROW("Virtual texture " + path + " is truncated");
+    }
+
+    texture.resident_slots.assign(page_count, INVALID_SLOT);
+    texture.page_table.assign(page_count, 0);
+
+    // The page table has a level per mip, one texel per page
+    VkExtent3D table_extent = { texture.pages_x[0], texture.pages_y[0], 1 };
+    VkImageCreateInfo img_info = vkinit::image_create_info(VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, table_extent);
+    img_info.mipLevels = mip_count;
+
+    VmaAllocationCreateInfo img_alloc_info = {};
+    img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    img_alloc_info.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VK_CHECK(vmaCreateImage(allocator, &img_info, &img_alloc_info, &texture.page_table_image, &texture.page_table_allocation, nullptr));
+
+    VkImageViewCreateInfo view_info = vkinit::imageview_create_info(VK_FORMAT_R32_UINT, texture.page_table_image, VK_IMAGE_ASPECT_COLOR_BIT);
+    view_info.subresourceRange.levelCount = mip_count;
+    VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &texture.page_table_view));
+
+    texture.page_table_index = heap->add_sampled_image(texture.page_table_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // The coarsest mip is a single page that every lookup can fall back to, it stays resident for good
+    if(free_slots.empty()) {
+        discard_last_texture();
+        LOG_THROW("Virtual texture cache: no room for the coarsest mip of " + path);
+    }
+
+    u32 root_mip = mip_count - 1;
+    u32 root_slot = free_slots.back();
+    free_slots.pop_back();
+
+    slots[root_slot] = { make_page_id(texture_id, root_mip, 0, 0), 0, true, {} };
+    texture.resident_slots[texture.first_page[root_mip]] = root_slot;
+    resident_page_count++;
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { (i32)((root_slot % desc.pages_per_side) * slot_size), (i32)((root_slot / desc.pages_per_side) * slot_size), 0 };
+    region.imageExtent = { slot_size, slot_size, 1 };
+
+    u32 atlas_size = slot_size * desc.pages_per_side;
+    vk_staged_image staged = uploader->stage_image(atlas, {atlas_size, atlas_size, 1}, 1, get_page_bytes(), { &region, 1 }, false,
+                                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, atlas_layout);
+    atlas_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    file.seekg((std::streamoff)(sizeof(header) + (u64)texture.first_page[root_mip] * get_page_bytes()));
+    file.read((char*)staged.data, get_page_bytes());
+
+    if(!file) {
+        // The copy into the slot still runs, the slot just goes back to the free ones and gets overwritten later
+        discard_last_texture();
+        LOG_THROW("Failed to read virtual texture " + path);
+    }
+
+    texture.page_table_dirty = true;
+    upload_page_table(texture);
+
+    {
+        std::lock_guard lock(load_mutex);
+        loader_paths.push_back(path);
+    }
+
+    return texture_id;
+}
+
+void vk_virtual_texture_cache::discard_last_texture() {
+    virtual_texture& texture = textures.back();
+
+    for(u32 slot : texture.resident_slots) {
+        if(slot == INVALID_SLOT) continue;
+
+        slots[slot] = { INVALID_PAGE, 0, false, {} };
+        free_slots.push_back(slot);
+        resident_page_count--;
+    }
+
+    // Nothing recorded references the page table yet, it can go right away
+    heap->remove_sampled_image(texture.page_table_index);
+    vkDestroyImageView(device, texture.page_table_view, nullptr);
+    vmaDestroyImage(allocator, texture.page_table_image, texture.page_table_allocation);
+
+    textures.pop_back();
+}
+
+void vk_virtual_texture_cache::update(u32 frame_index) {
+    // Nothing samples the cache yet, so there is no feedback to read and nothing to stream
+    if(textures.empty()) return;
+
+    update_count++;
+
+    frame_data& frame = frames[frame_index];
+
+    read_feedback(frame);
+    upload_loaded_pages();
+
+    for(virtual_texture& texture : textures) {
+        if(texture.page_table_dirty) {
+            upload_page_table(texture);
+        }
+    }
+
+    write_system(frame);
+}
+
+void vk_virtual_texture_cache::record_feedback_barrier(VkCommandBuffer cmd) {
+    if(textures.empty()) return;
+
+    VkMemoryBarrier2 barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    barrier.pNext = nullptr;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+    VkDependencyInfo dep_info = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dep_info.pNext = nullptr;
+    dep_info.memoryBarrierCount = 1;
+    dep_info.pMemoryBarriers = &barrier;
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+}
+
+void vk_virtual_texture_cache::read_feedback(frame_data& frame) {
+    // The frame that wrote it has retired, so this never waits on the gpu
+    VK_CHECK(vmaInvalidateAllocation(allocator, frame.feedback_buffer.allocation, 0, VK_WHOLE_SIZE));
+
+    auto& feedback = *(vk_gpu_virtual_texture_feedback*)frame.feedback_buffer.info.pMappedData;
+    const u32* ids = (const u32*)((u8*)frame.feedback_buffer.info.pMappedData + sizeof(vk_gpu_virtual_texture_feedback));
+
+    u32 count = std::min(feedback.count, desc.feedback_capacity);
+    requests.assign(ids, ids + count);
+
+    feedback.count = 0;
+    VK_CHECK(vmaFlushAllocation(allocator, frame.feedback_buffer.allocation, 0, sizeof(vk_gpu_virtual_texture_feedback)));
+
+    // Neighbouring pixels mostly ask for the same pages
+    std::sort(requests.begin(), requests.end());
+    requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+
+    std::vector<page_load> new_loads;
+
+    for(u32 page_id : requests) {
+        u32 texture_id, mip, x, y;
+        decode_page_id(page_id, texture_id, mip, x, y);
+
+        if(texture_id >= textures.size()) continue;
+
+        virtual_texture& texture = textures[texture_id];
+        if(mip >= texture.mip_count || x >= texture.pages_x[mip] || y >= texture.pages_y[mip]) continue;
+
+        // Whatever the page table currently points at for this page was used, keep it around
+        for(u32 level = mip; level < texture.mip_count; level++) {
+            u32 shift = level - mip;
+            u32 slot = texture.resident_slots[texture.first_page[level] + (y >> shift) * texture.pages_x[level] + (x >> shift)];
+
+            if(slot != INVALID_SLOT) {
+                touch(slot);
+                break;
+            }
+        }
+
+        u32 page_index = texture.first_page[mip] + y * texture.pages_x[mip] + x;
+        if(texture.resident_slots[page_index] != INVALID_SLOT || loads_in_flight.contains(page_id)) continue;
+
+        if(loads_in_flight.size() + new_loads.size() >= VIRTUAL_TEXTURE_MAX_LOADS_IN_FLIGHT) continue;
+
+        new_loads.push_back({ page_id, texture_id, sizeof(vk_virtual_texture_file_header) + (u64)page_index * get_page_bytes() });
+    }
+
+    if(new_loads.empty()) return;
+
+    // Coarse pages first, they replace the blurriest fallbacks and cover the most pixels
+    std::stable_sort(new_loads.begin(), new_loads.end(), [](const page_load& a, const page_load& b) {
+        return ((a.page_id >> 20) & 0xF) > ((b.page_id >> 20) & 0xF);
+    });
+
+    for(const page_load& load : new_loads) {
+        loads_in_flight.insert(load.page_id);
+    }
+
+    {
+        std::lock_guard lock(load_mutex);
+        loads.insert(loads.end(), new_loads.begin(), new_loads.end());
+    }
+
+    load_cv.notify_one();
+}
+
+void vk_virtual_texture_cache::upload_loaded_pages() {
+    std::vector<VkBufferImageCopy> regions;
+    std::vector<loaded_page> accepted;
+
+    loaded_page page;
+    while(accepted.size() < desc.max_uploads_per_frame && loaded_pages.pop(page)) {
+        loads_in_flight.erase(page.page_id);
+
+        // A failed read gets requested again by the next feedback that still wants it
+        if(page.data.empty()) continue;
+
+        u32 texture_id, mip, x, y;
+        decode_page_id(page.page_id, texture_id, mip, x, y);
+
+        virtual_texture& texture = textures[texture_id];
+        u32 page_index = texture.first_page[mip] + y * texture.pages_x[mip] + x;
+
+        // Every slot holds a page the current frame asked for, more pages than that can't be on screen at once
+        u32 slot = allocate_slot();
+        if(slot == INVALID_SLOT) continue;
+
+        slots[slot].page_id = page.page_id;
+        slots[slot].last_used = update_count;
+        slots[slot].pinned = false;
+        slots[slot].lru = lru.insert(lru.end(), slot);
+
+        texture.resident_slots[page_index] = slot;
+        texture.page_table_dirty = true;
+        resident_page_count++;
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = (VkDeviceSize)accepted.size() * get_page_bytes();
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { (i32)((slot % desc.pages_per_side) * slot_size), (i32)((slot / desc.pages_per_side) * slot_size), 0 };
+        region.imageExtent = { slot_size, slot_size, 1 };
+
+        regions.push_back(region);
+        accepted.push_back(std::move(page));
+    }
+
+    if(accepted.empty()) return;
+
+    // Only the copied slots change, the rest of the atlas keeps its pages.
+    // Frames still sampling an evicted slot were submitted earlier on the same queue, the upload's barrier waits for them
+    u32 atlas_size = slot_size * desc.pages_per_side;
+    vk_staged_image staged = uploader->stage_image(atlas, {atlas_size, atlas_size, 1}, 1, (VkDeviceSize)accepted.size() * get_page_bytes(), regions, false,
+                                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, atlas_layout);
+    atlas_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    for(u32 i = 0; i < accepted.size(); i++) {
+        memcpy((u8*)staged.data + regions[i].bufferOffset, accepted[i].data.data(), get_page_bytes());
+    }
+}
+
+void vk_virtual_texture_cache::upload_page_table(virtual_texture& texture) {
+    // Pages that aren't resident point at the closest resident page of a coarser mip, so walk from the coarsest mip down
+    for(u32 m = texture.mip_count; m-- > 0;) {
+        for(u32 y = 0; y < texture.pages_y[m]; y++) {
+            for(u32 x = 0; x < texture.pages_x[m]; x++) {
+                u32 page_index = texture.first_page[m] + y * texture.pages_x[m] + x;
+                u32 slot = texture.resident_slots[page_index];
+
+                if(slot != INVALID_SLOT) {
+                    texture.page_table[page_index] = make_page_table_entry(slot, desc.pages_per_side, m);
+                } else if(m + 1 < texture.mip_count) {
+                    texture.page_table[page_index] = texture.page_table[texture.first_page[m + 1] + (y / 2) * texture.pages_x[m + 1] + x / 2];
+                } else {
+                    texture.page_table[page_index] = 0;
+                }
+            }
+        }
+    }
+
+    // Every level gets rewritten, so the old contents don't have to survive the copy
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize staging_size = 0;
+
+    for(u32 m = 0; m < texture.mip_count; m++) {
+        staging_size = (staging_size + 15) & ~(VkDeviceSize)15;
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = staging_size;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = m;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { texture.pages_x[m], texture.pages_y[m], 1 };
+        regions.push_back(region);
+
+        staging_size += texture.pages_x[m] * texture.pages_y[m] * sizeof(u32);
+    }
+
+    vk_staged_image staged = uploader->stage_image(texture.page_table_image, { texture.pages_x[0], texture.pages_y[0], 1 }, texture.mip_count, staging_size,
+                                                   regions, false, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    for(u32 m = 0; m < texture.mip_count; m++) {
+        memcpy((u8*)staged.data + regions[m].bufferOffset, &texture.page_table[texture.first_page[m]], texture.pages_x[m] * texture.pages_y[m] * sizeof(u32));
+    }
+
+    texture.page_table_dirty = false;
+}
+
+void vk_virtual_texture_cache::write_system(frame_data& frame) {
+    // The slot is idle whenever its frame gets recorded, so the cpu writes straight into it
+    auto& system = *(vk_gpu_virtual_texture_system*)frame.system_buffer.info.pMappedData;
+    system.feedback_buffer = frame.feedback_buffer_address;
+    system.atlas_index = atlas_index;
+    system.sampler_index = sampler_index;
+    system.page_size = desc.page_size;
+    system.page_border = desc.page_border;
+    system.atlas_size = slot_size * desc.pages_per_side;
+    system.feedback_phase = (u32)(update_count % VIRTUAL_TEXTURE_FEEDBACK_PERIOD);
+    system.texture_count = (u32)textures.size();
+
+    auto* gpu_textures = (vk_gpu_virtual_texture*)((u8*)frame.system_buffer.info.pMappedData + sizeof(vk_gpu_virtual_texture_system));
+    for(u32 i = 0; i < textures.size(); i++) {
+        gpu_textures[i] = { textures[i].page_table_index, textures[i].width, textures[i].height, textures[i].mip_count };
+    }
+
+    VK_CHECK(vmaFlushAllocation(allocator, frame.system_buffer.allocation, 0, VK_WHOLE_SIZE));
+}
+
+u32 vk_virtual_texture_cache::allocate_slot() {
+    if(!free_slots.empty()) {
+        u32 slot = free_slots.back();
+        free_slots.pop_back();
+        return slot;
+    }
+
+    if(lru.empty()) return INVALID_SLOT;
+
+    u32 slot = lru.front();
+    if(slots[slot].last_used == update_count) return INVALID_SLOT;
+
+    lru.pop_front();
+
+    u32 texture_id, mip, x, y;
+    decode_page_id(slots[slot].page_id, texture_id, mip, x, y);
+
+    virtual_texture& texture = textures[texture_id];
+    texture.resident_slots[texture.first_page[mip] + y * texture.pages_x[mip] + x] = INVALID_SLOT;
+    texture.page_table_dirty = true;
+
+    slots[slot].page_id = INVALID_PAGE;
+    resident_page_count--;
+
+    return slot;
+}
+
+void vk_virtual_texture_cache::touch(u32 slot) {
+    slots[slot].last_used = update_count;
+
+    if(!slots[slot].pinned) {
+        lru.splice(lru.end(), lru, slots[slot].lru);
+    }
+}
+
+void vk_virtual_texture_cache::loader_loop() {
+    std::vector<page_load> batch;
+    std::vector<std::ifstream> files; // Indexed by texture, opened on first use
+    u32 page_bytes = get_page_bytes();
+
+    while(true) {
+        {
+            std::unique_lock lock(load_mutex);
+            load_cv.wait(lock, [this]() { return stopping || !loads.empty(); });
+
+            if(stopping) break;
+
+            batch.swap(loads);
+
+            while(files.size() < loader_paths.size()) {
+                files.emplace_back(loader_paths[files.size()], std::ios::binary);
+            }
+        }
+
+        for(const page_load& load : batch) {
+            loaded_page page{};
+            page.page_id = load.page_id;
+
+            std::ifstream& file = files[load.texture];
+            file.clear();
+            file.seekg((std::streamoff)load.file_offset);
+
+            page.data.resize(page_bytes);
+            file.read((char*)page.data.data(), page_bytes);
+
+            if(!file) {
+                LOG_INFO("Failed to read a page of virtual texture " << load.texture);
+                page.data.clear();
+            }
+
+            // In flight loads never outnumber the queue, so this only spins while the render thread is stalled
+            while(!loaded_pages.push(std::move(page)) && !stopping) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        batch.clear();
+    }
+}
+
+vk_allocated_buffer vk_virtual_texture_cache::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VkDeviceAddress* address) {
+    VkBufferCreateInfo buffer_info = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.pNext = nullptr;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+
+    if(address) {
+        buffer_info.usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    }
+
+    // Both kinds of buffers are host visible and stay mapped
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = memory_usage;
+    alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    vk_allocated_buffer buffer;
+    VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer.buffer, &buffer.allocation, &buffer.info));
+
+    if(address) {
+        VkBufferDeviceAddressInfo address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer.buffer };
+        *address = vkGetBufferDeviceAddress(device, &address_info);
+    }
+
+    return buffer;
+}
+
+u32 vk_virtual_texture_cache::get_page_bytes() const {
+    return slot_size * slot_size * 4;
+}
@@ -0,0 +1,222 @@
+//
+// Created by user on 17.10.2026.
+//
+
+#ifndef VK_VIRTUAL_TEXTURE_H
+#define VK_VIRTUAL_TEXTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "vk_descriptors.h"
+#include "vk_sync.h"
+#include "vk_types.h"
+#include "vk_uploader.h"
+
+constexpr u32 VIRTUAL_TEXTURE_MAX_TEXTURES = 256; // Page ids keep the texture in 8 bits
+constexpr u32 VIRTUAL_TEXTURE_MAX_MIPS = 16;
+constexpr u32 VIRTUAL_TEXTURE_MAX_PAGES_PER_SIDE = 1024; // Page ids keep x and y in 10 bits each
+constexpr u32 VIRTUAL_TEXTURE_FEEDBACK_PERIOD = 16; // Matches VT_FEEDBACK_PERIOD in virtual_texture.glsl
+constexpr u32 VIRTUAL_TEXTURE_MAX_LOADS_IN_FLIGHT = 256;
+
+// Layout matches VirtualTexture in virtual_texture.glsl
+struct vk_gpu_virtual_texture {
+    u32 page_table_index; // Bindless sampled image, R32_UINT with a level per mip
+    u32 width;
+    u32 height;
+    u32 mip_count;
+};
+
+// Layout matches VirtualTextureSystem in virtual_texture.glsl, the textures follow right after it
+struct vk_gpu_virtual_texture_system {
+    VkDeviceAddress feedback_buffer;
+    u32 atlas_index;
+    u32 sampler_index;
+    u32 page_size; // Texels a page covers per side
+    u32 page_border; // Texels copied from the neighbours on each side, so bilinear filtering doesn't bleed across pages
+    u32 atlas_size;
+    u32 feedback_phase; // Which pixel of every 4x4 block writes feedback this frame
+    u32 texture_count;
+    u32 padding[3];
+};
+
+// Layout matches VirtualTextureFeedback in virtual_texture.glsl, the requested page ids follow
+struct vk_gpu_virtual_texture_feedback {
+    u32 count;
+    u32 capacity;
+    u32 padding[2];
+};
+
+struct vk_virtual_texture_cache_desc {
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; // Every file the cache streams from has to use it
+    u32 page_size = 128;
+    u32 page_border = 4;
+    u32 pages_per_side = 32; // The physical cache holds pages_per_side^2 pages
+    u32 feedback_capacity = 16384; // Page requests a frame can write
+    u32 max_uploads_per_frame = 32;
+};
+
+// Textures far bigger than video memory, split into pages that are streamed in as the screen asks for them.
+// Shaders look up the physical page in a page table and write the pages they wanted into a feedback buffer, which is read
+// back once the frame retired. A loader thread reads the missing pages from disk, the render thread copies them into an LRU
+// managed atlas and falls back to the closest coarser resident mip until they arrive. The coarsest mip stays resident.
+//
+// Files are tiled by the asset pipeline: a vk_virtual_texture_file_header followed by every page of mip 0 in row major order,
+// then mip 1 and so on. Each page is stored with its border, (page_size + 2 * page_border)^2 texels
+class vk_virtual_texture_cache {
+public:
+    void init(VkDevice device, VmaAllocator allocator, vk_uploader* uploader, vk_bindless_heap* heap, u32 frame_count, const vk_virtual_texture_cache_desc& desc);
+
+    /**
+     *  @brief Stops the loader thread and frees the cache, the gpu has to be done with it
+     */
+    void destroy();
+
+    /**
+     *  @brief Opens a tiled texture and makes its coarsest mip resident, returns the id shaders sample it with. Throws on files that don't match the cache
+     */
+    u32 load(const std::string& path);
+
+    /**
+     *  @brief Reads the feedback the frame slot wrote last time, queues the missing pages and uploads the ones the loader finished.
+     *  Call it once the slot's previous frame retired and before the uploader gets flushed. Does nothing until a texture is loaded
+     */
+    void update(u32 frame_index);
+
+    /**
+     *  @brief Makes the feedback the frame's shaders wrote visible to the host, record it after the last pass sampling virtual textures.
+     *  Records nothing until a texture is loaded
+     */
+    void record_feedback_barrier(VkCommandBuffer cmd);
+
+    /**
+     *  @brief Address of the VirtualTextureSystem the frame slot's shaders read
+     */
+    VkDeviceAddress get_system_address(u32 frame_index) const { return frames[frame_index].system_buffer_address; }
+
+    u32 get_resident_page_count() const { return resident_page_count; }
+    u32 get_page_capacity() const { return (u32)slots.size(); }
+
+private:
+    struct virtual_texture {
+        std::string path;
+        u32 width;
+        u32 height;
+        u32 mip_count;
+        std::array<u32, VIRTUAL_TEXTURE_MAX_MIPS> pages_x; // Per mip
+        std::array<u32, VIRTUAL_TEXTURE_MAX_MIPS> pages_y;
+        std::array<u32, VIRTUAL_TEXTURE_MAX_MIPS> first_page; // Index of the mip's first page, in the file and in resident_slots
+
+        std::vector<u32> resident_slots; // Atlas slot of every page, INVALID_SLOT when it isn't resident
+        std::vector<u32> page_table; // Cpu copy of every level, rebuilt when residency changes
+        bool page_table_dirty;
+
+        VkImage page_table_image;
+        VmaAllocation page_table_allocation;
+        VkImageView page_table_view;
+        u32 page_table_index;
+    };
+
+    struct cache_slot {
+        u32 page_id; // Page living in the slot, INVALID_PAGE when free
+        u64 last_used; // Update it was last requested in
+        bool pinned; // Coarsest mips are never evicted
+        std::list<u32>::iterator lru; // Position in lru, valid when the slot is neither free nor pinned
+    };
+
+    struct page_load {
+        u32 page_id;
+        u32 texture;
+        u64 file_offset;
+    };
+
+    struct loaded_page {
+        u32 page_id;
+        std::vector<u8> data; // Empty when the read failed
+    };
+
+    struct frame_data {
+        vk_allocated_buffer feedback_buffer; // Written by the gpu, read back by the cpu
+        VkDeviceAddress feedback_buffer_address;
+        vk_allocated_buffer system_buffer; // Persistently mapped
+        VkDeviceAddress system_buffer_address;
+    };
+
+    void loader_loop();
+
+    // Undoes a load that failed after its page table was created, only valid for the texture added last
+    void discard_last_texture();
+
+    void read_feedback(frame_data& frame);
+
+    // Copies the pages the loader finished into the atlas, evicting the least recently used ones
+    void upload_loaded_pages();
+
+    void upload_page_table(virtual_texture& texture);
+    void write_system(frame_data& frame);
+
+    // Claims a free slot, or the least recently used one that wasn't requested in this update. INVALID_SLOT when every page is in use
+    u32 allocate_slot();
+
+    void touch(u32 slot);
+
+    vk_allocated_buffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VkDeviceAddress* address);
+
+    u32 get_page_bytes() const;
+
+    VkDevice device;
+    VmaAllocator allocator;
+    vk_uploader* uploader;
+    vk_bindless_heap* heap;
+    vk_virtual_texture_cache_desc desc;
+
+    VkImage atlas;
+    VmaAllocation atlas_allocation;
+    VkImageView atlas_view;
+    VkImageLayout atlas_layout; // UNDEFINED until the first page lands
+    u32 atlas_index;
+    u32 slot_size; // page_size plus the borders
+
+    VkSampler sampler; // Linear, clamped, the borders take care of filtering across pages
+    u32 sampler_index;
+
+    std::vector<frame_data> frames;
+
+    std::vector<virtual_texture> textures;
+    std::vector<cache_slot> slots;
+    std::vector<u32> free_slots;
+    std::list<u32> lru; // Least recently used first
+    u32 resident_page_count = 0;
+    u64 update_count = 0;
+
+    std::vector<u32> requests; // Scratch for the feedback of one frame
+    std::unordered_set<u32> loads_in_flight;
+
+    // Loads waiting for the loader thread, guarded by load_mutex
+    std::thread loader;
+    std::mutex load_mutex;
+    std::condition_variable load_cv;
+    std::vector<page_load> loads;
+    std::vector<std::string> loader_paths; // Indexed by texture, the loader opens the files on its own
+    std::atomic<bool> stopping{false};
+
+    vk_spsc_queue<loaded_page, VIRTUAL_TEXTURE_MAX_LOADS_IN_FLIGHT> loaded_pages;
+};
+
+// What the asset pipeline writes in front of the pages
+struct vk_virtual_texture_file_header {
+    u32 magic; // VIRTUAL_TEXTURE_MAGIC
+    u32 format; // VkFormat of the texels
+    u32 width;
+    u32 height;
+    u32 page_size;
+    u32 page_border;
+    u32 mip_count; // Down to the mip that fits into a single page
+    u32 reserved;
+};
+
+#endif //VK_VIRTUAL_TEXTURE_H